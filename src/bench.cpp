@@ -0,0 +1,325 @@
+/*
+ * src/bench.cpp
+ *
+ * Copyright (c) 2025 Omar Berrow
+*/
+
+// Microbenchmarks of the renderer's hot functions, and whole-frame benchmarks over generated scenes.
+// Every result is printed as one JSON object per line, so runs can be collected and compared over time.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <ctime>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "renderer.hpp"
+#include "headless.hpp"
+#include "scene.hpp"
+#include "scene-gen.hpp"
+
+using namespace raytracer;
+
+namespace raytracer {
+    // Gives the benchmarks access to the renderer's private hot functions.
+    struct bench
+    {
+        static const renderable_object* closest_hit_primary(const renderer& r, viewport_coords dir, float& t)
+        {
+            const renderer::frame_job& frame = *r.m_frame.load();
+            return r.closest_hit<renderer::RAY_PRIMARY>(frame, frame.scene->camera_position, dir, 1, INFINITY, t);
+        }
+        static const renderable_object* closest_hit_secondary(const renderer& r, viewport_coords origin, viewport_coords dir, float& t)
+        { return r.closest_hit<renderer::RAY_SECONDARY>(*r.m_frame.load(), origin, dir, .001f, INFINITY, t); }
+        static bool ray_intersects_object(const renderer& r, viewport_coords origin, viewport_coords dir, float t_min, float t_max)
+        { return r.ray_intersects_object(*r.m_frame.load(), origin, dir, t_min, t_max); }
+        static float compute_lighting(const renderer& r, viewport_coords intersection, glm::vec3 normal, glm::vec3 view, float shininess)
+        { return r.compute_lighting(*r.m_frame.load(), intersection, normal, view, shininess); }
+        static color trace_ray(const renderer& r, viewport_coords origin, viewport_coords dir, int recurse_limit)
+        { return r.trace_ray(*r.m_frame.load(), origin, dir, 1, INFINITY, recurse_limit); }
+        static color trace_primary(const renderer& r, viewport_coords dir, int recurse_limit)
+        { return r.trace_primary(*r.m_frame.load(), dir, recurse_limit); }
+    };
+}
+
+struct bench_options
+{
+    FILE* out = stdout;
+    int frames = 5;
+    int micro_iterations = 2000000;
+    double max_work = 5e8;
+    // 100000 spheres only fit under the default max_work at the smallest resolution,
+    // larger scenes have to be asked for with --spheres and --max-work.
+    std::vector<size_t> sphere_counts = {10, 100, 1000, 10000, 100000};
+    std::vector<std::pair<int, int>> resolutions = {{80,60}, {160,120}, {320,240}, {640,480}};
+    std::vector<size_t> thread_counts = {};
+    bool micro = true;
+    bool frame = true;
+};
+
+static volatile uint64_t s_sink;
+
+static double median(std::vector<double> v)
+{
+    std::sort(v.begin(), v.end());
+    return v.size() % 2 ? v[v.size()/2] : (v[v.size()/2-1] + v[v.size()/2]) / 2;
+}
+
+// Runs fn(i) for i in [0, iterations) a few times, and returns the best time per call in ns.
+template<typename F>
+static double time_per_op(int iterations, F fn)
+{
+    double best = INFINITY;
+    for (int rep = 0; rep < 5; rep++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        uint64_t acc = 0;
+        for (int i = 0; i < iterations; i++)
+            acc += fn(i);
+        auto end = std::chrono::steady_clock::now();
+        s_sink = s_sink + acc;
+        best = std::min(best, std::chrono::duration<double, std::nano>(end - start).count() / iterations);
+    }
+    return best;
+}
+
+static void report_micro(const bench_options& opts, const char* name, int iterations, double ns)
+{
+    fprintf(opts.out, "{\"kind\":\"micro\",\"name\":\"%s\",\"iterations\":%d,\"ns_per_op\":%.3f}\n", name, iterations, ns);
+    fflush(opts.out);
+}
+
+static void run_micro(const bench_options& opts)
+{
+    headless_image img{64, 48};
+    renderer r = {(int)img.width, (int)img.height, headless_plot_pixel, &img, s_bg_color, 3};
+    for (auto& obj : objects)
+        r.append_object(&obj);
+    r.set_camera_rotation(glm::rotate(glm::mat4(1), 0.f, glm::vec3(0,0,1)));
+    // Publishes the scene snapshot the hot functions read.
+    r.render();
+    r.wait_for_frame();
+
+    // One primary ray per pixel of a small grid, cycled through by every benchmark.
+    std::vector<viewport_coords> dirs;
+    for (int y = -24; y < 24; y++)
+        for (int x = -32; x < 32; x++)
+            dirs.push_back({x/32.f, y/24.f, 1});
+    const viewport_coords origin = {0,0,0};
+    const int n = opts.micro_iterations;
+
+    // The closest-hit kernels over every sphere of the scene.
+    double ns = time_per_op(n, [&](int i) {
+        float t = INFINITY;
+        return (uint64_t)(bench::closest_hit_primary(r, dirs[i % dirs.size()], t) != nullptr);
+    });
+    report_micro(opts, "closest_hit/primary", n, ns);
+
+    ns = time_per_op(n, [&](int i) {
+        float t = INFINITY;
+        return (uint64_t)(bench::closest_hit_secondary(r, origin, dirs[i % dirs.size()], t) != nullptr);
+    });
+    report_micro(opts, "closest_hit/secondary", n, ns);
+
+    // The any-hit kernel of shadow rays.
+    ns = time_per_op(n, [&](int i) {
+        return (uint64_t)bench::ray_intersects_object(r, origin, dirs[i % dirs.size()], 1, INFINITY);
+    });
+    report_micro(opts, "ray_intersects_object", n, ns);
+
+    // Shade the points primary rays hit.
+    struct hit { viewport_coords at; glm::vec3 normal; float shininess; };
+    std::vector<hit> points;
+    for (auto& dir : dirs)
+    {
+        float t = INFINITY;
+        const renderable_object* sphere = bench::closest_hit_primary(r, dir, t);
+        if (!sphere)
+            continue;
+        viewport_coords at = t * dir;
+        points.push_back({at, glm::normalize(at - sphere->position), sphere->shininess});
+    }
+    ns = time_per_op(n / 4, [&](int i) {
+        auto& p = points[i % points.size()];
+        return (uint64_t)(bench::compute_lighting(r, p.at, p.normal, -p.at, p.shininess) * 1000);
+    });
+    report_micro(opts, "compute_lighting", n / 4, ns);
+
+    for (int depth = 0; depth <= 3; depth += 3)
+    {
+        ns = time_per_op(n / 16, [&](int i) {
+            return (uint64_t)bench::trace_ray(r, origin, dirs[i % dirs.size()], depth);
+        });
+        std::string name = "trace_ray/depth=" + std::to_string(depth);
+        report_micro(opts, name.c_str(), n / 16, ns);
+
+        // The same rays, through the primary ray kernel.
+        ns = time_per_op(n / 16, [&](int i) {
+            return (uint64_t)bench::trace_primary(r, dirs[i % dirs.size()], depth);
+        });
+        name = "trace_primary/depth=" + std::to_string(depth);
+        report_micro(opts, name.c_str(), n / 16, ns);
+    }
+}
+
+static void run_frames(const bench_options& opts)
+{
+    for (size_t nSpheres : opts.sphere_counts)
+    {
+        auto over_budget = [&](int width, int height) { return (double)nSpheres * width * height > opts.max_work; };
+        // Generating the big scenes takes a while, so don't for nothing.
+        if (std::all_of(opts.resolutions.begin(), opts.resolutions.end(), [&](auto res) { return res.first <= 0 || res.second <= 0 || over_budget(res.first, res.second); }))
+        {
+            fprintf(stderr, "skipping %zu spheres at every resolution (over --max-work)\n", nSpheres);
+            continue;
+        }
+        std::vector<renderable_object> scene = generate_scene(nSpheres, 1);
+        for (auto [width, height] : opts.resolutions)
+        {
+            if (width <= 0 || height <= 0)
+                continue;
+            if (over_budget(width, height))
+            {
+                fprintf(stderr, "skipping %zu spheres at %dx%d (over --max-work)\n", nSpheres, width, height);
+                continue;
+            }
+            headless_image img(width, height);
+            renderer r = {width, height, headless_plot_pixel, &img, s_bg_color, 3};
+            for (auto& obj : scene)
+                r.append_object(&obj);
+            r.set_camera_rotation(glm::rotate(glm::mat4(1), 0.f, glm::vec3(0,0,1)));
+            for (size_t threads : opts.thread_counts)
+            {
+                r.set_worker_count(threads);
+                std::vector<double> times;
+                for (int frame = 0; frame < opts.frames; frame++)
+                {
+                    r.set_mutated();
+                    auto start = std::chrono::steady_clock::now();
+                    r.render();
+                    r.wait_for_frame();
+                    auto end = std::chrono::steady_clock::now();
+                    times.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+                }
+                double min = *std::min_element(times.begin(), times.end());
+                double med = median(times);
+                double mean = 0;
+                for (double t : times)
+                    mean += t;
+                mean /= times.size();
+                fprintf(opts.out,
+                    "{\"kind\":\"frame\",\"spheres\":%zu,\"width\":%d,\"height\":%d,\"threads\":%zu,\"frames\":%d,"
+                    "\"min_ms\":%.3f,\"median_ms\":%.3f,\"mean_ms\":%.3f,\"mrays_per_s\":%.3f}\n",
+                    nSpheres, width, height, r.get_worker_count(), opts.frames,
+                    min, med, mean, (double)width*height / (med*1000));
+                fflush(opts.out);
+            }
+        }
+    }
+}
+
+template<typename T>
+static std::vector<T> parse_list(const char* arg, T(*parse)(const char*))
+{
+    std::vector<T> ret;
+    std::string s = arg;
+    size_t pos = 0;
+    while (pos <= s.size())
+    {
+        size_t comma = s.find(',', pos);
+        if (comma == std::string::npos)
+            comma = s.size();
+        ret.push_back(parse(s.substr(pos, comma - pos).c_str()));
+        pos = comma + 1;
+    }
+    return ret;
+}
+
+static void usage(const char* argv0)
+{
+    fprintf(stderr,
+        "Usage: %s [options]\n"
+        "  --out FILE         write results to FILE instead of stdout\n"
+        "  --frames N         frames rendered per configuration (default 5)\n"
+        "  --spheres A,B,...  sphere counts of the generated scenes (default 10 to 100000)\n"
+        "  --res WxH,...      resolutions\n"
+        "  --threads A,B,...  worker thread counts (default 1 and the renderer's default)\n"
+        "  --max-work N       skip configurations where spheres*pixels exceeds N (default 5e8, \"inf\" runs everything)\n"
+        "  --micro-only       only run the microbenchmarks\n"
+        "  --frame-only       only run the whole-frame benchmarks\n",
+        argv0);
+}
+
+int main(int argc, char** argv)
+{
+    bench_options opts = {};
+    for (int i = 1; i < argc; i++)
+    {
+        const char* arg = argv[i];
+        const char* val = (i + 1 < argc) ? argv[i + 1] : nullptr;
+        if (!strcmp(arg, "--micro-only"))
+            opts.frame = false;
+        else if (!strcmp(arg, "--frame-only"))
+            opts.micro = false;
+        else if (!val)
+        {
+            usage(argv[0]);
+            return -1;
+        }
+        else if (!strcmp(arg, "--out"))
+        {
+            opts.out = fopen(val, "w");
+            if (!opts.out)
+            {
+                perror(val);
+                return -1;
+            }
+            i++;
+        }
+        else if (!strcmp(arg, "--frames") && ++i)
+            opts.frames = std::max(1, atoi(val));
+        else if (!strcmp(arg, "--max-work") && ++i)
+            opts.max_work = strtod(val, nullptr);
+        else if (!strcmp(arg, "--spheres") && ++i)
+            opts.sphere_counts = parse_list<size_t>(val, [](const char* s) -> size_t { return strtoull(s, nullptr, 0); });
+        else if (!strcmp(arg, "--threads") && ++i)
+            opts.thread_counts = parse_list<size_t>(val, [](const char* s) -> size_t { return strtoull(s, nullptr, 0); });
+        else if (!strcmp(arg, "--res") && ++i)
+            opts.resolutions = parse_list<std::pair<int, int>>(val, [](const char* s) -> std::pair<int, int> {
+                int w = 0, h = 0;
+                sscanf(s, "%dx%d", &w, &h);
+                return {w, h};
+            });
+        else
+        {
+            usage(argv[0]);
+            return -1;
+        }
+    }
+    if (opts.thread_counts.empty())
+    {
+        size_t def = std::thread::hardware_concurrency()*1.5;
+        opts.thread_counts = {1};
+        if (def > 1)
+            opts.thread_counts.push_back(def);
+    }
+
+    fprintf(opts.out, "{\"kind\":\"meta\",\"timestamp\":%lld,\"hardware_concurrency\":%u}\n",
+        (long long)time(nullptr), std::thread::hardware_concurrency());
+    if (opts.micro)
+        run_micro(opts);
+    if (opts.frame)
+        run_frames(opts);
+    if (opts.out != stdout)
+        fclose(opts.out);
+    return 0;
+}
@@ -0,0 +1,96 @@
+/*
+ * src/epoch.hpp
+ *
+ * Copyright (c) 2025 Omar Berrow
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace raytracer {
+    // Epoch-based reclamation for RCU-style publication: a single writer swaps an atomic pointer
+    // to a new object and retires the old one, and a fixed set of reader threads bracket their
+    // use of the pointer with enter() and exit().
+    // Retired objects are freed by reclaim() once every reader that could still see them has left.
+    //
+    // A reader announces the global epoch before loading the pointer. An object retired at epoch R
+    // was unlinked before the epoch reached R, so a reader that announced R or later can't have it.
+    class epoch_domain
+    {
+        public:
+            explicit epoch_domain(size_t readers = 0) { resize(readers); }
+            epoch_domain(const epoch_domain&) = delete;
+            ~epoch_domain() { free_all(); }
+
+            // Only while no reader is inside. Frees everything retired so far.
+            void resize(size_t readers)
+            {
+                free_all();
+                m_slots.reset(readers ? new slot[readers] : nullptr);
+                m_readers = readers;
+            }
+
+            inline void enter(size_t reader) { m_slots[reader].epoch.store(m_global.load()); }
+            inline void exit(size_t reader) { m_slots[reader].epoch.store(0, std::memory_order_release); }
+
+            // Writer only, after the object has been unlinked.
+            template<typename T>
+            void retire(T* obj)
+            {
+                if (!obj)
+                    return;
+                uint64_t epoch = m_global.fetch_add(1) + 1;
+                m_retired.push_back({epoch, obj, [](void* p) { delete static_cast<T*>(p); }});
+            }
+
+            // Writer only. Never waits for readers.
+            void reclaim()
+            {
+                uint64_t oldest = UINT64_MAX;
+                for (size_t i = 0; i < m_readers; i++)
+                {
+                    uint64_t epoch = m_slots[i].epoch.load();
+                    if (epoch && epoch < oldest)
+                        oldest = epoch;
+                }
+                size_t kept = 0;
+                for (auto& obj : m_retired)
+                {
+                    if (obj.epoch <= oldest)
+                        obj.free(obj.ptr);
+                    else
+                        m_retired[kept++] = obj;
+                }
+                m_retired.resize(kept);
+            }
+
+        private:
+            void free_all()
+            {
+                for (auto& obj : m_retired)
+                    obj.free(obj.ptr);
+                m_retired.clear();
+            }
+
+            // Padded so readers don't share cache lines.
+            struct alignas(64) slot
+            {
+                // 0 while the reader is outside.
+                std::atomic<uint64_t> epoch = 0;
+            };
+            struct retired_object
+            {
+                uint64_t epoch;
+                void* ptr;
+                void(*free)(void*);
+            };
+            std::unique_ptr<slot[]> m_slots;
+            size_t m_readers = 0;
+            std::atomic<uint64_t> m_global = 1;
+            std::vector<retired_object> m_retired;
+    };
+}
@@ -0,0 +1,264 @@
+/*
+ * src/golden.cpp
+ *
+ * Copyright (c) 2025 Omar Berrow
+*/
+
+// Renders a fixed set of scenes headlessly and compares them against the reference images
+// in tests/golden/, failing if any of them drifts below a PSNR tolerance.
+// Run with --update after an intentional change to the output to regenerate the references.
+
+#include <chrono>
+#include <cmath>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "renderer.hpp"
+#include "headless.hpp"
+#include "scene.hpp"
+#include "scene-gen.hpp"
+
+using namespace raytracer;
+
+struct golden_scene
+{
+    const char* name;
+    std::vector<renderable_object> objects;
+    viewport_coords camera_position;
+    glm::mat3x3 camera_rotation;
+};
+
+static constexpr int s_width = 160;
+static constexpr int s_height = 120;
+
+static std::vector<golden_scene> make_scenes()
+{
+    const glm::mat3x3 identity = glm::rotate(glm::mat4(1), 0.f, glm::vec3(0,0,1));
+    std::vector<renderable_object> scene_hpp{std::begin(objects), std::end(objects)};
+    return {
+        {"scene", scene_hpp, {0,0,0}, identity},
+        {"scene-moved", scene_hpp, {1,-.5f,-1}, glm::rotate(glm::mat4(1), glm::radians(-15.f), glm::vec3(0,1,0))},
+        {"generated-64", generate_scene(64, 7), {0,0,0}, identity},
+        {"generated-1000", generate_scene(1000, 42), {0,0,0}, identity},
+    };
+}
+
+// A renderer drawing scene into img, which both have to outlive it.
+static std::unique_ptr<renderer> make_renderer(golden_scene& scene, headless_image& img, size_t nWorkers)
+{
+    auto r = std::make_unique<renderer>(s_width, s_height, headless_plot_pixel, &img, s_bg_color, 3);
+    r->set_worker_count(nWorkers);
+    for (auto& obj : scene.objects)
+        r->append_object(&obj);
+    r->set_camera_position(scene.camera_position);
+    r->set_camera_rotation(scene.camera_rotation);
+    return r;
+}
+
+static headless_image render_scene(golden_scene& scene, size_t nWorkers)
+{
+    headless_image img{s_width, s_height};
+    auto r = make_renderer(scene, img, nWorkers);
+    r->render();
+    r->wait_for_frame();
+    return img;
+}
+
+// A deferred renderer must draw exactly what a forward renderer draws, both after
+// shading-only edits (reusing its G-buffer) and after geometry edits (rebuilding it).
+static bool check_deferred()
+{
+    golden_scene base = make_scenes()[0];
+    std::vector<renderable_object>& scene = base.objects;
+    const glm::mat3x3 identity = base.camera_rotation;
+    headless_image deferred_img{s_width, s_height};
+    auto owner = make_renderer(base, deferred_img, 4);
+    renderer& deferred = *owner;
+    deferred.set_deferred(true);
+    deferred.render();
+    deferred.wait_for_frame();
+
+    auto compare = [&](const char* what) {
+        golden_scene forward = {what, scene, deferred.get_camera_position(), identity};
+        if (render_scene(forward, 4).pixels == deferred_img.pixels)
+        {
+            printf("ok   deferred: %s\n", what);
+            return true;
+        }
+        printf("FAIL deferred: %s differs from a forward render\n", what);
+        return false;
+    };
+
+    // Materials and lights.
+    scene[0].rgbx = 0x00ffff00;
+    scene[1].shininess = 10;
+    scene[2].reflectiveness = .8f;
+    scene[5].light.intensity = .9f;
+    deferred.set_mutated(MUTATION_SHADING);
+    deferred.render();
+    deferred.wait_for_frame();
+    bool ok = compare("shading edit");
+
+    deferred.set_camera_position({0,-.5f,-1});
+    deferred.render();
+    deferred.wait_for_frame();
+    ok = compare("camera move") && ok;
+
+    // A geometry edit passed off as a shading one has to be drawn from the stale primary hits,
+    // or the G-buffer isn't actually being reused.
+    scene[0].position.x += .5f;
+    deferred.set_mutated(MUTATION_SHADING);
+    deferred.render();
+    deferred.wait_for_frame();
+    golden_scene moved = {"moved sphere", scene, deferred.get_camera_position(), identity};
+    if (render_scene(moved, 4).pixels == deferred_img.pixels)
+    {
+        printf("FAIL deferred: a shading-only frame traced primary rays again\n");
+        ok = false;
+    }
+    else
+        printf("ok   deferred: shading-only frames reuse primary hits\n");
+    deferred.set_mutated(MUTATION_GEOMETRY);
+    deferred.render();
+    deferred.wait_for_frame();
+    ok = compare("geometry edit") && ok;
+    return ok;
+}
+
+// Workers draw the scene as it was at render(), so the application can go on editing its
+// objects while they do.
+static bool check_snapshot()
+{
+    golden_scene scene = make_scenes()[0];
+    headless_image expected = render_scene(scene, 4);
+
+    headless_image img{s_width, s_height};
+    auto r = make_renderer(scene, img, 4);
+    r->render();
+    for (auto& obj : scene.objects)
+    {
+        obj.position.x += 1;
+        obj.rgbx = ~obj.rgbx;
+    }
+    r->remove_object(&scene.objects[0]);
+    r->set_camera_position({0,0,-5});
+    r->wait_for_frame();
+    if (img.pixels != expected.pixels)
+    {
+        printf("FAIL snapshot: edits made after render() showed up in its frame\n");
+        return false;
+    }
+    printf("ok   snapshot: edits after render() wait for the next frame\n");
+    return true;
+}
+
+// Once the scene stops changing, frames the governor degraded are refined back to full quality.
+static bool check_refinement()
+{
+    golden_scene scene = make_scenes()[2];
+    headless_image img{s_width, s_height};
+    auto owner = make_renderer(scene, img, 4);
+    renderer& r = *owner;
+    // An impossible budget, so that the governor goes all the way down.
+    r.set_target_frame_time(std::chrono::microseconds(1));
+    for (int i = 0; i < 10; i++)
+    {
+        r.set_camera_position(scene.camera_position + viewport_coords(0, 0, (9 - i) * .1f));
+        r.render();
+        r.wait_for_frame();
+    }
+    if (!r.get_quality().level)
+    {
+        printf("FAIL refinement: the governor didn't lower the quality\n");
+        return false;
+    }
+    for (int i = 0; i < 20; i++)
+    {
+        r.render();
+        r.wait_for_frame();
+    }
+    if (r.get_quality().level || img.pixels != render_scene(scene, 4).pixels)
+    {
+        printf("FAIL refinement: a static scene stayed at quality level %d\n", r.get_quality().level);
+        return false;
+    }
+    printf("ok   refinement: a static scene returns to full quality\n");
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    std::string dir = "tests/golden";
+    double tolerance = 40;
+    bool update = false;
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "--update"))
+            update = true;
+        else if (!strcmp(argv[i], "--tolerance") && i + 1 < argc)
+            tolerance = strtod(argv[++i], nullptr);
+        else if (argv[i][0] != '-')
+            dir = argv[i];
+        else
+        {
+            fprintf(stderr, "Usage: %s [--update] [--tolerance dB] [reference directory]\n", argv[0]);
+            return -1;
+        }
+    }
+
+    int failures = 0;
+    for (auto& scene : make_scenes())
+    {
+        std::string ref_path = dir + "/" + scene.name + ".ppm";
+        headless_image img = render_scene(scene, 4);
+        // The split of lines between workers must not change the image.
+        headless_image single = render_scene(scene, 1);
+        if (single.pixels != img.pixels)
+        {
+            printf("FAIL %s: single-threaded render differs from multi-threaded render\n", scene.name);
+            failures++;
+            continue;
+        }
+
+        if (update)
+        {
+            if (!write_ppm(img, ref_path.c_str()))
+                return -1;
+            printf("wrote %s\n", ref_path.c_str());
+            continue;
+        }
+
+        headless_image ref;
+        if (!read_ppm(ref, ref_path.c_str()))
+        {
+            printf("FAIL %s: could not read %s (run with --update to create it)\n", scene.name, ref_path.c_str());
+            failures++;
+            continue;
+        }
+        double db = psnr(img, ref);
+        if (db < tolerance)
+        {
+            std::string actual_path = dir + "/" + scene.name + ".actual.ppm";
+            write_ppm(img, actual_path.c_str());
+            printf("FAIL %s: PSNR %.2f dB < %.2f dB, wrote %s\n", scene.name, db, tolerance, actual_path.c_str());
+            failures++;
+        }
+        else
+            printf("ok   %s: PSNR %.2f dB\n", scene.name, db);
+    }
+    if (!update && !check_deferred())
+        failures++;
+    if (!update && !check_snapshot())
+        failures++;
+    if (!update && !check_refinement())
+        failures++;
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,87 @@
+/*
+ * src/headless.cpp
+ *
+ * Copyright (c) 2025 Omar Berrow
+*/
+
+#include <cassert>
+#include <cmath>
+#include <stdio.h>
+
+#include "headless.hpp"
+
+namespace raytracer {
+    void headless_plot_pixel(void* userdata, const screen_coords& at, uint32_t rgbx)
+    {
+        headless_image* img = reinterpret_cast<headless_image*>(userdata);
+        assert(at.x < img->width);
+        assert(at.y < img->height);
+        img->pixels[static_cast<size_t>(at.y)*img->width + at.x] = rgbx;
+    }
+
+    bool write_ppm(const headless_image& img, const char* path)
+    {
+        FILE* f = fopen(path, "wb");
+        if (!f)
+        {
+            perror(path);
+            return false;
+        }
+        fprintf(f, "P6\n%u %u\n255\n", img.width, img.height);
+        for (color c : img.pixels)
+        {
+            uint8_t rgb[3] = { uint8_t(c >> 24), uint8_t((c >> 16) & 0xff), uint8_t((c >> 8) & 0xff) };
+            fwrite(rgb, 1, 3, f);
+        }
+        bool ok = !ferror(f);
+        fclose(f);
+        return ok;
+    }
+
+    bool read_ppm(headless_image& img, const char* path)
+    {
+        FILE* f = fopen(path, "rb");
+        if (!f)
+            return false;
+        unsigned int w = 0, h = 0, maxval = 0;
+        if (fscanf(f, "P6 %u %u %u", &w, &h, &maxval) != 3 || maxval != 255 || fgetc(f) == EOF)
+        {
+            fprintf(stderr, "%s: not an 8-bit binary PPM\n", path);
+            fclose(f);
+            return false;
+        }
+        img = headless_image{w, h};
+        for (color& c : img.pixels)
+        {
+            uint8_t rgb[3] = {};
+            if (fread(rgb, 1, 3, f) != 3)
+            {
+                fprintf(stderr, "%s: truncated image\n", path);
+                fclose(f);
+                return false;
+            }
+            c = (uint32_t(rgb[0]) << 24) | (uint32_t(rgb[1]) << 16) | (uint32_t(rgb[2]) << 8);
+        }
+        fclose(f);
+        return true;
+    }
+
+    double psnr(const headless_image& a, const headless_image& b)
+    {
+        if (a.width != b.width || a.height != b.height)
+            return -1;
+        double sq_err = 0;
+        for (size_t i = 0; i < a.pixels.size(); i++)
+        {
+            for (int shift = 8; shift <= 24; shift += 8)
+            {
+                double d = double((a.pixels[i] >> shift) & 0xff) - double((b.pixels[i] >> shift) & 0xff);
+                sq_err += d*d;
+            }
+        }
+        if (sq_err == 0)
+            return INFINITY;
+        double mse = sq_err / (a.pixels.size()*3);
+        return 10*log10(255.0*255.0 / mse);
+    }
+}
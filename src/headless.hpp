@@ -0,0 +1,36 @@
+/*
+ * src/headless.hpp
+ *
+ * Copyright (c) 2025 Omar Berrow
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "renderer.hpp"
+
+namespace raytracer {
+    // An in-memory render target, for frontends that have no window.
+    struct headless_image
+    {
+        unsigned int width = 0, height = 0;
+        std::vector<color> pixels;
+
+        headless_image() = default;
+        headless_image(unsigned int w, unsigned int h)
+            : width(w), height(h), pixels(static_cast<size_t>(w)*h, 0)
+        {}
+        inline color at(unsigned int x, unsigned int y) const { return pixels[static_cast<size_t>(y)*width + x]; }
+    };
+    // Pass as the renderer's plot_pixel_cb with a headless_image* as userdata.
+    void headless_plot_pixel(void* userdata, const screen_coords& at, uint32_t rgbx);
+
+    // Binary PPM (P6), 8 bits per channel.
+    bool write_ppm(const headless_image& img, const char* path);
+    bool read_ppm(headless_image& img, const char* path);
+    // Peak signal-to-noise ratio over the RGB channels, in dB.
+    // Returns INFINITY for identical images, and -1 if the dimensions differ.
+    double psnr(const headless_image& a, const headless_image& b);
+}
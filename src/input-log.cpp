@@ -0,0 +1,281 @@
+/*
+ * src/input-log.cpp
+ *
+ * Copyright (c) 2025 Omar Berrow
+*/
+
+#include <algorithm>
+#include <cinttypes>
+#include <cmath>
+
+#include <stdio.h>
+#include <string.h>
+
+#include "input-log.hpp"
+
+namespace raytracer {
+    static const char s_log_header[] = "# raytracer input log 1";
+
+    bool apply_camera_key(char key, viewport_coords& camera_pos)
+    {
+        switch (key) {
+            case CAMERA_KEY_FORWARD:
+                camera_pos.z++;
+                break;
+            case CAMERA_KEY_BACKWARD:
+                camera_pos.z--;
+                break;
+            case CAMERA_KEY_LEFT:
+                camera_pos.x--;
+                break;
+            case CAMERA_KEY_RIGHT:
+                camera_pos.x++;
+                break;
+            case CAMERA_KEY_UP:
+                camera_pos.y--;
+                break;
+            case CAMERA_KEY_DOWN:
+                camera_pos.y++;
+                break;
+            default: return false;
+        }
+        return true;
+    }
+
+    uint64_t latency_histogram::percentile(double p) const
+    {
+        if (m_samples.empty())
+            return 0;
+        std::vector<uint64_t> sorted = m_samples;
+        std::sort(sorted.begin(), sorted.end());
+        size_t rank = (size_t)std::ceil(p * sorted.size());
+        return sorted[std::clamp(rank, (size_t)1, sorted.size()) - 1];
+    }
+
+    void latency_histogram::report(FILE* out, const char* name) const
+    {
+        if (m_samples.empty())
+        {
+            fprintf(out, "%s: no samples\n", name);
+            return;
+        }
+        uint64_t sum = 0;
+        size_t buckets[64] = {};
+        int lowest = 63, highest = 0;
+        for (uint64_t us : m_samples)
+        {
+            sum += us;
+            int bucket = us ? 63 - __builtin_clzll(us) : 0;
+            buckets[bucket]++;
+            lowest = std::min(lowest, bucket);
+            highest = std::max(highest, bucket);
+        }
+        fprintf(out, "%s: n=%zu mean=%.3f ms p50=%.3f ms p95=%.3f ms p99=%.3f ms max=%.3f ms\n",
+            name, m_samples.size(), sum / 1000.0 / m_samples.size(),
+            percentile(.50) / 1000.0, percentile(.95) / 1000.0, percentile(.99) / 1000.0,
+            percentile(1) / 1000.0);
+        size_t most = *std::max_element(buckets, buckets + 64);
+        for (int bucket = lowest; bucket <= highest; bucket++)
+        {
+            char bar[41] = {};
+            memset(bar, '#', buckets[bucket] * 40 / most);
+            fprintf(out, "  [%10.3f ms, %10.3f ms) %8zu %s\n",
+                (bucket ? (1ull << bucket) : 0) / 1000.0, (2ull << bucket) / 1000.0, buckets[bucket], bar);
+        }
+    }
+
+    input_session::~input_session()
+    {
+        if (m_record_file)
+            fclose(m_record_file);
+        if (m_stats_file)
+            fclose(m_stats_file);
+    }
+
+    int input_session::parse_arg(int argc, char** argv, int i)
+    {
+        const char* val = (i + 1 < argc) ? argv[i + 1] : nullptr;
+        if (!strcmp(argv[i], "--max-speed"))
+        {
+            m_max_speed = true;
+            return 1;
+        }
+        if (!strcmp(argv[i], "--fixed-quality"))
+        {
+            m_fixed_quality = true;
+            return 1;
+        }
+        if (strcmp(argv[i], "--record") && strcmp(argv[i], "--replay") && strcmp(argv[i], "--stats"))
+            return 0;
+        if (!val)
+        {
+            fprintf(stderr, "%s needs a file name\n", argv[i]);
+            return -1;
+        }
+        bool ok = false;
+        if (!strcmp(argv[i], "--record"))
+            ok = record_to(val);
+        else if (!strcmp(argv[i], "--replay"))
+            ok = replay_from(val, m_max_speed);
+        else
+            ok = write_stats_to(val);
+        return ok ? 2 : -1;
+    }
+
+    bool input_session::record_to(const char* path)
+    {
+        m_record_file = fopen(path, "w");
+        if (!m_record_file)
+        {
+            perror(path);
+            return false;
+        }
+        fprintf(m_record_file, "%s\n", s_log_header);
+        return true;
+    }
+
+    bool input_session::replay_from(const char* path, bool max_speed)
+    {
+        FILE* f = fopen(path, "r");
+        if (!f)
+        {
+            perror(path);
+            return false;
+        }
+        char line[256] = {};
+        int lineno = 0;
+        while (fgets(line, sizeof(line), f))
+        {
+            lineno++;
+            if (line[0] == '#' || line[0] == '\n')
+                continue;
+            input_event ev = {};
+            if (sscanf(line, "%" SCNu64 " %c %f %f %f", &ev.time_us, &ev.key,
+                       &ev.camera_position.x, &ev.camera_position.y, &ev.camera_position.z) != 5)
+            {
+                fprintf(stderr, "%s:%d: malformed event\n", path, lineno);
+                fclose(f);
+                return false;
+            }
+            m_events.push_back(ev);
+        }
+        fclose(f);
+        m_replaying = true;
+        m_max_speed = m_max_speed || max_speed;
+        m_next_event = 0;
+        return true;
+    }
+
+    bool input_session::write_stats_to(const char* path)
+    {
+        m_stats_file = fopen(path, "w");
+        if (!m_stats_file)
+        {
+            perror(path);
+            return false;
+        }
+        fprintf(m_stats_file, "frame,frame_us,events,input_latency_us,quality_level\n");
+        return true;
+    }
+
+    uint64_t input_session::now_us() const
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(clock::now() - m_start).count();
+    }
+
+    void input_session::configure(renderer& r, int target_fps) const
+    {
+        r.set_target_fps(m_fixed_quality ? 0 : target_fps);
+    }
+
+    void input_session::frame_start(const renderer& r)
+    {
+        // Event times are relative to the first frame, so that setup time isn't part of the log.
+        if (!m_frames && m_frame_start == clock::time_point{})
+            m_start = clock::now();
+        m_frame_start = clock::now();
+        m_flushed_frame = r.get_flushed_frame();
+    }
+
+    void input_session::present_input(renderer& r) const
+    {
+        if (input_pending())
+            r.wait_for_frame();
+    }
+
+    bool input_session::live_key(char key, viewport_coords& camera_pos)
+    {
+        if (!apply_camera_key(key, camera_pos))
+            return false;
+        uint64_t now = now_us();
+        m_pending.push_back(now);
+        if (m_record_file)
+            fprintf(m_record_file, "%" PRIu64 " %c %.9g %.9g %.9g\n", now, key, camera_pos.x, camera_pos.y, camera_pos.z);
+        return true;
+    }
+
+    bool input_session::replay_events(viewport_coords& camera_pos)
+    {
+        const uint64_t now = now_us();
+        bool changed = false;
+        while (m_next_event < m_events.size())
+        {
+            const input_event& ev = m_events[m_next_event];
+            if (!m_max_speed && ev.time_us > now)
+                break;
+            apply_camera_key(ev.key, camera_pos);
+            // The log has the last word, so that one desync doesn't throw off the rest of the replay.
+            if (!(camera_pos == ev.camera_position))
+            {
+                m_desyncs++;
+                camera_pos = ev.camera_position;
+            }
+            changed = true;
+            // At the recorded speed, lateness in applying the event counts towards its latency.
+            m_pending.push_back(m_max_speed ? now : ev.time_us);
+            m_next_event++;
+            if (m_max_speed)
+                break;
+        }
+        return changed;
+    }
+
+    void input_session::frame_presented(const renderer& r)
+    {
+        if (r.get_flushed_frame() == m_flushed_frame)
+        {
+            m_idle_iterations++;
+            return;
+        }
+        const uint64_t now = now_us();
+        const uint64_t frame_us = std::chrono::duration_cast<std::chrono::microseconds>(clock::now() - m_frame_start).count();
+        m_frame_times.add(frame_us);
+        uint64_t worst = 0;
+        for (uint64_t t : m_pending)
+        {
+            uint64_t latency = now > t ? now - t : 0;
+            m_input_latency.add(latency);
+            worst = std::max(worst, latency);
+        }
+        if (m_stats_file)
+        {
+            const int level = r.get_quality().level;
+            if (m_pending.empty())
+                fprintf(m_stats_file, "%" PRIu64 ",%" PRIu64 ",0,,%d\n", m_frames, frame_us, level);
+            else
+                fprintf(m_stats_file, "%" PRIu64 ",%" PRIu64 ",%zu,%" PRIu64 ",%d\n", m_frames, frame_us, m_pending.size(), worst, level);
+        }
+        m_pending.clear();
+        m_frames++;
+    }
+
+    void input_session::report(FILE* out) const
+    {
+        fprintf(out, "frames: %" PRIu64 ", idle iterations: %" PRIu64 ", input events: %zu", m_frames, m_idle_iterations, m_input_latency.size());
+        if (m_replaying)
+            fprintf(out, ", replay desyncs: %zu", m_desyncs);
+        fprintf(out, "\n");
+        m_frame_times.report(out, "frame time");
+        m_input_latency.report(out, "input-to-present latency");
+    }
+}
@@ -0,0 +1,124 @@
+/*
+ * src/input-log.hpp
+ *
+ * Copyright (c) 2025 Omar Berrow
+*/
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+#include <stdio.h>
+
+#include "renderer.hpp"
+
+namespace raytracer {
+    // The camera moves of the interactive frontends, as recorded in input logs.
+    enum camera_key : char {
+        CAMERA_KEY_FORWARD = 'w',
+        CAMERA_KEY_BACKWARD = 's',
+        CAMERA_KEY_LEFT = 'a',
+        CAMERA_KEY_RIGHT = 'd',
+        CAMERA_KEY_UP = 'u',
+        CAMERA_KEY_DOWN = 'j',
+    };
+    // Returns false if key isn't a camera_key.
+    bool apply_camera_key(char key, viewport_coords& camera_pos);
+
+    // One line of an input log: "<time in us> <key> <camera x> <camera y> <camera z>",
+    // where the camera position is the one after applying the key.
+    struct input_event
+    {
+        uint64_t time_us;
+        char key;
+        viewport_coords camera_position;
+    };
+
+    class latency_histogram
+    {
+        public:
+            inline void add(uint64_t us) { m_samples.push_back(us); }
+            inline size_t size() const { return m_samples.size(); }
+            // p in [0,1].
+            uint64_t percentile(double p) const;
+            // Prints a summary line and one line per power-of-two bucket.
+            void report(FILE* out, const char* name) const;
+
+        private:
+            std::vector<uint64_t> m_samples;
+    };
+
+    // Drives the input of a frontend loop: live, live while recording to a log, or replayed from a log.
+    // Also collects per-frame timings, which are reported by report().
+    //
+    // A frontend calls configure() on its renderer once, then frame_start() at the top of its loop,
+    // either live_key() for every key it reads or replay_events() once when replaying, render() with
+    // the new camera position, present_input() before putting the frame on screen, and frame_presented()
+    // at the end of the loop. Loop iterations that didn't put a new frame on screen are only counted,
+    // so that they don't show up as frame times, and input stays pending until a new frame is presented.
+    class input_session
+    {
+        public:
+            input_session() = default;
+            input_session(const input_session&) = delete;
+            ~input_session();
+
+            // Handles argv[i] if it's one of --record FILE, --replay FILE, --max-speed, --stats FILE or --fixed-quality.
+            // Returns how many arguments were used, 0 if it isn't one of those, or -1 on error.
+            int parse_arg(int argc, char** argv, int i);
+            static constexpr const char* usage = "[--record FILE | --replay FILE [--max-speed]] [--stats FILE] [--fixed-quality]";
+
+            bool record_to(const char* path);
+            // With max_speed, one event is applied per frame regardless of its timestamp.
+            bool replay_from(const char* path, bool max_speed);
+            // Also writes "frame,frame_us,events,input_latency_us,quality_level" lines for every frame to path.
+            bool write_stats_to(const char* path);
+
+            inline bool recording() const { return m_record_file != nullptr; }
+            inline bool replaying() const { return m_replaying; }
+            inline bool max_speed() const { return m_max_speed; }
+            // The governor is on unless --fixed-quality was given, live or replaying, so that replays
+            // reproduce what was seen live. Fixed quality makes replays render the same frames on any machine.
+            inline bool fixed_quality() const { return m_fixed_quality; }
+
+            void configure(renderer& r, int target_fps) const;
+            // True once every replayed event has been applied and presented.
+            inline bool replay_done() const { return m_replaying && m_next_event == m_events.size() && m_pending.empty(); }
+
+            void frame_start(const renderer& r);
+            // Returns true if the key moved the camera.
+            bool live_key(char key, viewport_coords& camera_pos);
+            // Applies every replayed event that is due. Returns true if the camera moved.
+            bool replay_events(viewport_coords& camera_pos);
+            inline bool input_pending() const { return !m_pending.empty(); }
+            // Waits for the frame that has the pending input in it, so that latency is measured up to when it's presented.
+            void present_input(renderer& r) const;
+            void frame_presented(const renderer& r);
+            void report(FILE* out) const;
+
+        private:
+            using clock = std::chrono::steady_clock;
+            uint64_t now_us() const;
+
+            clock::time_point m_start = clock::now();
+            clock::time_point m_frame_start = {};
+            FILE* m_record_file = nullptr;
+            FILE* m_stats_file = nullptr;
+            bool m_replaying = false;
+            bool m_max_speed = false;
+            bool m_fixed_quality = false;
+            // renderer::get_flushed_frame() at frame_start().
+            uint64_t m_flushed_frame = 0;
+            std::vector<input_event> m_events;
+            size_t m_next_event = 0;
+            size_t m_desyncs = 0;
+            // Times of the events applied since the last present.
+            std::vector<uint64_t> m_pending;
+            uint64_t m_frames = 0;
+            uint64_t m_idle_iterations = 0;
+            latency_histogram m_frame_times;
+            latency_histogram m_input_latency;
+    };
+}
@@ -0,0 +1,88 @@
+/*
+ * src/main-headless.cpp
+ *
+ * Copyright (c) 2025 Omar Berrow
+*/
+
+// Frontend without a display, for replaying input logs recorded by the other frontends
+// on machines that have no window system or framebuffer.
+
+#include <chrono>
+#include <thread>
+
+#include <glm/geometric.hpp>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <string.h>
+#include <stdio.h>
+
+#include "renderer.hpp"
+#include "headless.hpp"
+#include "input-log.hpp"
+#include "scene.hpp"
+
+constexpr int target_fps = 60;
+
+using namespace raytracer;
+
+int main(int argc, char** argv)
+{
+    input_session session = {};
+    int width = 640, height = 480;
+    const char* out_path = nullptr;
+    for (int i = 1; i < argc; )
+    {
+        if (!strcmp(argv[i], "--size") && i + 1 < argc && sscanf(argv[i + 1], "%dx%d", &width, &height) == 2 && width > 0 && height > 0)
+        {
+            i += 2;
+            continue;
+        }
+        if (!strcmp(argv[i], "--out") && i + 1 < argc)
+        {
+            out_path = argv[i + 1];
+            i += 2;
+            continue;
+        }
+        int used = session.parse_arg(argc, argv, i);
+        if (used <= 0)
+        {
+            fprintf(stderr, "Usage: %s [--size WxH] [--out last-frame.ppm] %s\n", argv[0], input_session::usage);
+            return -1;
+        }
+        i += used;
+    }
+
+    headless_image img(width, height);
+    renderer renderer = {width, height, headless_plot_pixel, &img, s_bg_color, 3};
+    for (int i = 0; i < sizeof(objects)/sizeof(*objects); i++)
+        renderer.append_object(&objects[i]);
+
+    bool quit = false;
+    viewport_coords camera_pos = {};
+    glm::mat3x3 camera_rot = glm::rotate(glm::mat4(1), 0.f, glm::vec3(0,0,1));
+    renderer.set_camera_rotation(camera_rot);
+    session.configure(renderer, target_fps);
+    constexpr std::chrono::milliseconds target_fps_duration_ms = std::chrono::milliseconds((int)(1.f/(float)target_fps*1000.f));
+    do {
+        auto start = std::chrono::steady_clock::now();
+        session.frame_start(renderer);
+        if (session.replay_events(camera_pos))
+            renderer.set_camera_position(camera_pos);
+        renderer.render();
+        renderer.wait_for_frame();
+        session.frame_presented(renderer);
+        // Without a log to replay, there's nothing after the first frame.
+        quit = !session.replaying() || session.replay_done();
+        if (quit || session.max_speed())
+            continue;
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        if (elapsed < target_fps_duration_ms)
+            std::this_thread::sleep_for(target_fps_duration_ms - elapsed);
+    } while(!quit);
+
+    if (out_path && !write_ppm(img, out_path))
+        return -1;
+    session.report(stdout);
+    return 0;
+}
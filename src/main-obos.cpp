@@ -28,6 +28,7 @@
 #include <obos/error.h>
 
 #include "renderer.hpp"
+#include "input-log.hpp"
 #include "scene.hpp"
 
 constexpr int target_fps = 60;
@@ -64,8 +65,20 @@ struct framebuffer {
 #define OBOS_FB_FORMAT_RGBX8888 3
 #define OBOS_FB_FORMAT_XRGB8888 4
 
-int main()
+int main(int argc, char** argv)
 {
+    input_session session = {};
+    for (int i = 1; i < argc; )
+    {
+        int used = session.parse_arg(argc, argv, i);
+        if (used <= 0)
+        {
+            fprintf(stderr, "Usage: %s %s\n", argv[0], input_session::usage);
+            return -1;
+        }
+        i += used;
+    }
+
     int fb0_fd = open("/dev/fb0", O_RDWR);
     if (fb0_fd < 0)
     {
@@ -158,6 +171,7 @@ int main()
     viewport_coords camera_pos = {};
     glm::mat3x3 camera_rot = glm::rotate(glm::mat4(1), 0.f, glm::vec3(0,0,1));
     renderer.set_camera_rotation(camera_rot);
+    session.configure(renderer, target_fps);
     constexpr std::chrono::milliseconds target_fps_duration_ms = std::chrono::milliseconds((int)(1.f/(float)target_fps*1000.f));
     struct timespec timeout = {};
     timeout.tv_nsec = 0;
@@ -172,6 +186,7 @@ int main()
     tcsetattr(0, 0, &term);
     do {
         auto start = std::chrono::time_point_cast<std::chrono::milliseconds>(std::chrono::system_clock::now());
+        session.frame_start(renderer);
         renderer.render();
         char c = 0;
         if (pselect(1, &stdin_set, nullptr, nullptr, &timeout, nullptr))
@@ -182,32 +197,34 @@ int main()
         bool changed_camera_pos = false;
         switch (c) {
             case 0: break;
-            case 'w':
-                camera_pos.z++;
-                changed_camera_pos = true;
-                break;
-            case 's':
-                camera_pos.z--;
-                changed_camera_pos = true;
-                break;
-            case 'a':
-                camera_pos.x--;
-                changed_camera_pos = true;
-                break;
-            case 'd':
-                camera_pos.x++;
-                changed_camera_pos = true;
-                break;
             case '\x1b': quit = true; break;
+            default:
+                if (!session.replaying())
+                    changed_camera_pos = session.live_key(c, camera_pos);
+                break;
         }
         c = 0;
+        if (session.replaying())
+            changed_camera_pos = session.replay_events(camera_pos);
         if (changed_camera_pos)
+        {
             renderer.set_camera_position(camera_pos);
+            renderer.render();
+        }
+        session.present_input(renderer);
+        session.frame_presented(renderer);
+        if (session.replay_done())
+            quit = true;
         auto end = std::chrono::time_point_cast<std::chrono::milliseconds>(std::chrono::system_clock::now());
 
         // if ((end - start).count() > 5)
         //     printf("frame time = %ld ms\n", (end - start).count());
-        if ((end-start) >= target_fps_duration_ms)
+        if (session.max_speed())
+            continue;
+        if ((end - start) < target_fps_duration_ms)
             std::this_thread::sleep_for(target_fps_duration_ms - (end - start));
     } while(!quit);
+
+    if (session.recording() || session.replaying())
+        session.report(stdout);
 }
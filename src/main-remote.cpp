@@ -0,0 +1,210 @@
+/*
+ * src/main-remote.cpp
+ *
+ * Copyright (c) 2025 Omar Berrow
+*/
+
+// Headless frontend that streams frames to a viewer (see viewer.cpp) over TCP.
+// Only the tiles that changed since the last frame sent are transmitted, and the viewer's
+// key presses are fed back in to move the camera.
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include <glm/geometric.hpp>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <poll.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+#include "renderer.hpp"
+#include "headless.hpp"
+#include "remote.hpp"
+#include "scene.hpp"
+
+constexpr int target_fps = 60;
+
+using namespace raytracer;
+
+static int listen_on(const char* addr, uint16_t port)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0)
+    {
+        perror("socket");
+        return -1;
+    }
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    sockaddr_in sin = {};
+    sin.sin_family = AF_INET;
+    sin.sin_port = htons(port);
+    if (inet_pton(AF_INET, addr, &sin.sin_addr) != 1)
+    {
+        fprintf(stderr, "%s: invalid address\n", addr);
+        close(fd);
+        return -1;
+    }
+    if (bind(fd, (sockaddr*)&sin, sizeof(sin)) < 0 || listen(fd, 1) < 0)
+    {
+        perror("bind/listen");
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Applies every key press waiting on the socket. Returns false once the client has gone away.
+static bool read_input(int client, viewport_coords& camera_pos, bool& changed)
+{
+    uint8_t keys[64];
+    ssize_t n = recv(client, keys, sizeof(keys), MSG_DONTWAIT);
+    if (n == 0)
+        return false;
+    if (n < 0)
+        return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+    for (ssize_t i = 0; i < n; i++)
+        changed |= apply_camera_key(keys[i], camera_pos);
+    return true;
+}
+
+// Sends the tiles of img that differ from sent, then brings sent up to date.
+// An empty sent image makes every tile be sent. Frames where nothing changed aren't sent at all.
+static bool send_frame(int client, uint32_t frame_index, const headless_image& img, headless_image& sent)
+{
+    using clock = std::chrono::steady_clock;
+    auto start = clock::now();
+
+    std::vector<uint8_t> tiles;
+    uint32_t tile_count = 0;
+    const unsigned int tiles_x = remote_tiles_x(img), tiles_y = remote_tiles_y(img);
+    const bool full = sent.pixels.size() != img.pixels.size();
+    for (unsigned int ty = 0; ty < tiles_y; ty++)
+    {
+        for (unsigned int tx = 0; tx < tiles_x; tx++)
+        {
+            if (!full && !remote_tile_differs(img, sent, tx, ty))
+                continue;
+            remote_put_u16(tiles, tx);
+            remote_put_u16(tiles, ty);
+            size_t size_at = tiles.size();
+            remote_put_u32(tiles, 0);
+            remote_encode_tile(img, tx, ty, tiles);
+            uint32_t size = tiles.size() - size_at - 4;
+            tiles[size_at+0] = size >> 24;
+            tiles[size_at+1] = (size >> 16) & 0xff;
+            tiles[size_at+2] = (size >> 8) & 0xff;
+            tiles[size_at+3] = size & 0xff;
+            tile_count++;
+        }
+    }
+    if (!tile_count)
+        return true;
+    std::vector<uint8_t> header;
+    remote_put_u32(header, frame_index);
+    remote_put_u32(header, tile_count);
+    remote_put_u32(header, tiles.size());
+    sent = img;
+
+    auto encoded = clock::now();
+    if (!remote_send_all(client, header.data(), header.size()) || !remote_send_all(client, tiles.data(), tiles.size()))
+        return false;
+    auto end = clock::now();
+
+    size_t bytes = header.size() + tiles.size();
+    printf("frame %u: %u/%u tiles, %zu bytes (%.1f%% of raw), encode %.3f ms, send %.3f ms\n",
+        frame_index, tile_count, tiles_x*tiles_y, bytes,
+        100.0 * bytes / (img.pixels.size()*3),
+        std::chrono::duration<double, std::milli>(encoded - start).count(),
+        std::chrono::duration<double, std::milli>(end - encoded).count());
+    fflush(stdout);
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    const char* addr = "127.0.0.1";
+    uint16_t port = remote_default_port;
+    int width = 640, height = 480;
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "--bind") && i + 1 < argc)
+            addr = argv[++i];
+        else if (!strcmp(argv[i], "--port") && i + 1 < argc)
+            port = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--size") && i + 1 < argc && sscanf(argv[++i], "%dx%d", &width, &height) == 2 && width > 0 && height > 0)
+            continue;
+        else
+        {
+            fprintf(stderr, "Usage: %s [--bind addr] [--port port] [--size WxH]\n", argv[0]);
+            return -1;
+        }
+    }
+
+    int server = listen_on(addr, port);
+    if (server < 0)
+        return -1;
+    printf("%s: listening on %s:%u, %dx%d\n", __func__, addr, port, width, height);
+
+    headless_image img(width, height);
+    renderer renderer = {width, height, headless_plot_pixel, &img, s_bg_color, 3};
+    for (int i = 0; i < sizeof(objects)/sizeof(*objects); i++)
+        renderer.append_object(&objects[i]);
+
+    viewport_coords camera_pos = {};
+    glm::mat3x3 camera_rot = glm::rotate(glm::mat4(1), 0.f, glm::vec3(0,0,1));
+    renderer.set_camera_rotation(camera_rot);
+    renderer.set_target_fps(target_fps);
+    constexpr std::chrono::milliseconds target_fps_duration_ms = std::chrono::milliseconds((int)(1.f/(float)target_fps*1000.f));
+    while (true)
+    {
+        int client = accept(server, nullptr, nullptr);
+        if (client < 0)
+        {
+            perror("accept");
+            continue;
+        }
+        int one = 1;
+        setsockopt(client, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        printf("%s: client connected\n", __func__);
+
+        // A new client has nothing yet, so its first frame has every tile.
+        headless_image sent;
+        uint32_t frame_index = 0;
+        bool connected = remote_send_hello(client, {(uint32_t)width, (uint32_t)height, remote_tile_size});
+        while (connected)
+        {
+            auto start = std::chrono::steady_clock::now();
+            renderer.render();
+            renderer.wait_for_frame();
+            connected = send_frame(client, frame_index++, img, sent);
+            if (!connected)
+                break;
+
+            // Sleep until either input arrives or the frame's time is up.
+            auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+            pollfd pfd = {client, POLLIN, 0};
+            if (elapsed < target_fps_duration_ms)
+                poll(&pfd, 1, (target_fps_duration_ms - elapsed).count());
+            bool changed = false;
+            connected = read_input(client, camera_pos, changed);
+            if (changed)
+                renderer.set_camera_position(camera_pos);
+        }
+        printf("%s: client disconnected\n", __func__);
+        close(client);
+    }
+
+    return 0;
+}
@@ -23,6 +23,7 @@
 #include <stdio.h>
 
 #include "renderer.hpp"
+#include "input-log.hpp"
 #include "scene.hpp"
 
 #define psdlerror(s) fprintf(stderr, "%s: %s\n", s, SDL_GetError())
@@ -31,8 +32,20 @@ constexpr int target_fps = 60;
 
 using namespace raytracer;
 
-int main()
+int main(int argc, char** argv)
 {
+    input_session session = {};
+    for (int i = 1; i < argc; )
+    {
+        int used = session.parse_arg(argc, argv, i);
+        if (used <= 0)
+        {
+            fprintf(stderr, "Usage: %s %s\n", argv[0], input_session::usage);
+            return -1;
+        }
+        i += used;
+    }
+
     if (SDL_Init(SDL_INIT_VIDEO) == -1)
     {
         psdlerror("SDL_Init");
@@ -94,37 +107,29 @@ int main()
     viewport_coords camera_pos = {};
     glm::mat3x3 camera_rot = glm::rotate(glm::mat4(1), 0.f, glm::vec3(0,0,1));
     renderer.set_camera_rotation(camera_rot);
-    constexpr std::chrono::milliseconds target_fps_duration_ms = std::chrono::milliseconds(1/target_fps*1000);
+    session.configure(renderer, target_fps);
+    constexpr std::chrono::milliseconds target_fps_duration_ms = std::chrono::milliseconds((int)(1.f/(float)target_fps*1000.f));
     do {
         auto start = std::chrono::time_point_cast<std::chrono::milliseconds>(std::chrono::system_clock::now());
+        session.frame_start(renderer);
         renderer.render();
 
         SDL_Event event = {};
         while (SDL_PollEvent(&event))
         {
-            if (event.type == SDL_KEYDOWN)
+            if (event.type == SDL_KEYDOWN && !session.replaying())
             {
+                char key = 0;
                 switch (event.key.keysym.sym) {
-                    case 'w':
-                        camera_pos.z++;
-                        break;
-                    case 's':
-                        camera_pos.z--;
-                        break;
-                    case 'a':
-                        camera_pos.x--;
-                        break;
-                    case 'd':
-                        camera_pos.x++;
-                        break;
-                    case SDLK_UP:
-                        camera_pos.y--;
-                        break;
-                    case SDLK_DOWN:
-                        camera_pos.y++;
-                        break;
+                    case 'w': key = CAMERA_KEY_FORWARD; break;
+                    case 's': key = CAMERA_KEY_BACKWARD; break;
+                    case 'a': key = CAMERA_KEY_LEFT; break;
+                    case 'd': key = CAMERA_KEY_RIGHT; break;
+                    case SDLK_UP: key = CAMERA_KEY_UP; break;
+                    case SDLK_DOWN: key = CAMERA_KEY_DOWN; break;
                     default: break;
                 }
+                session.live_key(key, camera_pos);
                 renderer.set_camera_position(camera_pos);
                 renderer.render();
             }
@@ -134,15 +139,29 @@ int main()
                 break;
             }
         }
+        if (session.replaying() && session.replay_events(camera_pos))
+        {
+            renderer.set_camera_position(camera_pos);
+            renderer.render();
+        }
+        session.present_input(renderer);
         auto end = std::chrono::time_point_cast<std::chrono::milliseconds>(std::chrono::system_clock::now());
 
-        if ((end - start).count() > 5)
-            printf("frame time = %ld ms\n", (end - start).count());
+        if ((end - start).count() > 5 && !session.replaying())
+            printf("frame time = %ld ms (quality level %d)\n", (end - start).count(), renderer.get_quality().level);
         SDL_UpdateWindowSurface(window);
-        if ((end-start) >= target_fps_duration_ms)
+        session.frame_presented(renderer);
+        if (session.replay_done())
+            quit = true;
+        if (session.max_speed())
+            continue;
+        if ((end - start) < target_fps_duration_ms)
             std::this_thread::sleep_for(target_fps_duration_ms - (end - start));
     } while(!quit);
 
+    if (session.recording() || session.replaying())
+        session.report(stdout);
+
     SDL_DestroyWindow(window);
     SDL_Quit();
 
@@ -0,0 +1,164 @@
+/*
+ * src/remote.cpp
+ *
+ * Copyright (c) 2025 Omar Berrow
+*/
+
+#include <algorithm>
+#include <cerrno>
+
+#include <sys/socket.h>
+#include <stdio.h>
+
+#include "remote.hpp"
+
+namespace raytracer {
+    bool remote_tile_differs(const headless_image& a, const headless_image& b, unsigned int tx, unsigned int ty)
+    {
+        const unsigned int x0 = tx*remote_tile_size, y0 = ty*remote_tile_size;
+        const unsigned int x1 = std::min(x0 + remote_tile_size, a.width), y1 = std::min(y0 + remote_tile_size, a.height);
+        for (unsigned int y = y0; y < y1; y++)
+        {
+            const color* row_a = &a.pixels[static_cast<size_t>(y)*a.width];
+            const color* row_b = &b.pixels[static_cast<size_t>(y)*b.width];
+            if (!std::equal(row_a + x0, row_a + x1, row_b + x0))
+                return true;
+        }
+        return false;
+    }
+
+    void remote_encode_tile(const headless_image& img, unsigned int tx, unsigned int ty, std::vector<uint8_t>& out)
+    {
+        const unsigned int x0 = tx*remote_tile_size, y0 = ty*remote_tile_size;
+        const unsigned int x1 = std::min(x0 + remote_tile_size, img.width), y1 = std::min(y0 + remote_tile_size, img.height);
+        color run_color = 0;
+        unsigned int run = 0;
+        auto flush = [&]() {
+            out.push_back(run - 1);
+            out.push_back(run_color >> 24);
+            out.push_back((run_color >> 16) & 0xff);
+            out.push_back((run_color >> 8) & 0xff);
+        };
+        for (unsigned int y = y0; y < y1; y++)
+        {
+            for (unsigned int x = x0; x < x1; x++)
+            {
+                // The low byte isn't sent, don't let it split runs.
+                color c = img.at(x, y) & 0xffffff00;
+                if (run && (c != run_color || run == 256))
+                {
+                    flush();
+                    run = 0;
+                }
+                run_color = c;
+                run++;
+            }
+        }
+        if (run)
+            flush();
+    }
+
+    bool remote_decode_tile(headless_image& img, unsigned int tx, unsigned int ty, const uint8_t* data, size_t size)
+    {
+        const unsigned int x0 = tx*remote_tile_size, y0 = ty*remote_tile_size;
+        if (x0 >= img.width || y0 >= img.height)
+            return false;
+        const unsigned int x1 = std::min(x0 + remote_tile_size, img.width), y1 = std::min(y0 + remote_tile_size, img.height);
+        unsigned int x = x0, y = y0;
+        for (size_t i = 0; i + 4 <= size; i += 4)
+        {
+            unsigned int run = data[i] + 1u;
+            color c = (uint32_t(data[i+1]) << 24) | (uint32_t(data[i+2]) << 16) | (uint32_t(data[i+3]) << 8);
+            while (run--)
+            {
+                if (y >= y1)
+                    return false;
+                img.pixels[static_cast<size_t>(y)*img.width + x] = c;
+                if (++x == x1)
+                {
+                    x = x0;
+                    y++;
+                }
+            }
+        }
+        return y == y1 && size % 4 == 0;
+    }
+
+    void remote_put_u16(std::vector<uint8_t>& out, uint16_t val)
+    {
+        out.push_back(val >> 8);
+        out.push_back(val & 0xff);
+    }
+    void remote_put_u32(std::vector<uint8_t>& out, uint32_t val)
+    {
+        remote_put_u16(out, val >> 16);
+        remote_put_u16(out, val & 0xffff);
+    }
+    uint16_t remote_get_u16(const uint8_t* in)
+    {
+        return (uint16_t(in[0]) << 8) | in[1];
+    }
+    uint32_t remote_get_u32(const uint8_t* in)
+    {
+        return (uint32_t(remote_get_u16(in)) << 16) | remote_get_u16(in + 2);
+    }
+
+    bool remote_send_all(int fd, const void* buf, size_t size)
+    {
+        const uint8_t* buf8 = (const uint8_t*)buf;
+        while (size)
+        {
+            ssize_t n = send(fd, buf8, size, MSG_NOSIGNAL);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0)
+                return false;
+            buf8 += n;
+            size -= n;
+        }
+        return true;
+    }
+
+    bool remote_recv_all(int fd, void* buf, size_t size)
+    {
+        uint8_t* buf8 = (uint8_t*)buf;
+        while (size)
+        {
+            ssize_t n = recv(fd, buf8, size, 0);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0)
+                return false;
+            buf8 += n;
+            size -= n;
+        }
+        return true;
+    }
+
+    bool remote_send_hello(int fd, const remote_hello& hello)
+    {
+        std::vector<uint8_t> msg;
+        remote_put_u32(msg, remote_magic);
+        remote_put_u32(msg, remote_version);
+        remote_put_u32(msg, hello.width);
+        remote_put_u32(msg, hello.height);
+        remote_put_u32(msg, hello.tile_size);
+        return remote_send_all(fd, msg.data(), msg.size());
+    }
+
+    bool remote_recv_hello(int fd, remote_hello& hello)
+    {
+        uint8_t msg[20] = {};
+        if (!remote_recv_all(fd, msg, sizeof(msg)))
+            return false;
+        if (remote_get_u32(msg) != remote_magic || remote_get_u32(msg+4) != remote_version)
+        {
+            fprintf(stderr, "remote: bad hello (magic %#x, version %u)\n", remote_get_u32(msg), remote_get_u32(msg+4));
+            return false;
+        }
+        hello.width = remote_get_u32(msg+8);
+        hello.height = remote_get_u32(msg+12);
+        hello.tile_size = remote_get_u32(msg+16);
+        return hello.tile_size == remote_tile_size;
+    }
+}
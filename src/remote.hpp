@@ -0,0 +1,71 @@
+/*
+ * src/remote.hpp
+ *
+ * Copyright (c) 2025 Omar Berrow
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+#include "headless.hpp"
+#include "input-log.hpp"
+
+// Wire protocol shared by the remote frontend (main-remote.cpp) and the viewer (viewer.cpp).
+// All integers are big-endian.
+//
+// Server -> client, once on connect:
+//     hello:  u32 magic ("RTRV"), u32 version, u32 width, u32 height, u32 tile_size
+// Server -> client, for every frame in which something changed:
+//     frame:  u32 frame_index, u32 tile_count, u32 payload_size, then tile_count tiles of
+//             u16 tile_x, u16 tile_y, u32 size, size bytes of RLE data
+// Client -> server:
+//     one byte per key press, see remote_key (the same as camera_key).
+//
+// Tile data is a run-length encoding of the tile's pixels in row-major order,
+// as [u8 run length - 1][u8 r][u8 g][u8 b] runs. Tiles on the right and bottom edges
+// are clipped to the image.
+
+namespace raytracer {
+    constexpr uint32_t remote_magic = 0x52545256; // "RTRV"
+    constexpr uint32_t remote_version = 1;
+    constexpr unsigned int remote_tile_size = 32;
+    constexpr uint16_t remote_default_port = 7878;
+
+    enum remote_key : uint8_t {
+        REMOTE_KEY_FORWARD = CAMERA_KEY_FORWARD,
+        REMOTE_KEY_BACKWARD = CAMERA_KEY_BACKWARD,
+        REMOTE_KEY_LEFT = CAMERA_KEY_LEFT,
+        REMOTE_KEY_RIGHT = CAMERA_KEY_RIGHT,
+        REMOTE_KEY_UP = CAMERA_KEY_UP,
+        REMOTE_KEY_DOWN = CAMERA_KEY_DOWN,
+    };
+
+    struct remote_hello
+    {
+        uint32_t width, height, tile_size;
+    };
+
+    inline unsigned int remote_tiles_x(const headless_image& img) { return (img.width + remote_tile_size - 1) / remote_tile_size; }
+    inline unsigned int remote_tiles_y(const headless_image& img) { return (img.height + remote_tile_size - 1) / remote_tile_size; }
+
+    bool remote_tile_differs(const headless_image& a, const headless_image& b, unsigned int tx, unsigned int ty);
+    // Appends the RLE encoding of tile (tx,ty) of img to out.
+    void remote_encode_tile(const headless_image& img, unsigned int tx, unsigned int ty, std::vector<uint8_t>& out);
+    // Decodes RLE data into tile (tx,ty) of img. Returns false on malformed data.
+    bool remote_decode_tile(headless_image& img, unsigned int tx, unsigned int ty, const uint8_t* data, size_t size);
+
+    void remote_put_u16(std::vector<uint8_t>& out, uint16_t val);
+    void remote_put_u32(std::vector<uint8_t>& out, uint32_t val);
+    uint16_t remote_get_u16(const uint8_t* in);
+    uint32_t remote_get_u32(const uint8_t* in);
+
+    // Blocking helpers that retry on short transfers. They return false once the peer is gone.
+    bool remote_send_all(int fd, const void* buf, size_t size);
+    bool remote_recv_all(int fd, void* buf, size_t size);
+
+    bool remote_send_hello(int fd, const remote_hello& hello);
+    bool remote_recv_hello(int fd, remote_hello& hello);
+}
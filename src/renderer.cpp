@@ -8,6 +8,7 @@
 #include <thread>
 #include <vector>
 #include <cassert>
+#include <climits>
 #include <cmath>
 #include <glm/common.hpp>
 #include <glm/geometric.hpp>
@@ -34,110 +35,442 @@ namespace raytracer {
         m_screen_start.y = -m_screen_middle.y;
         m_viewport_size.x = 1;
         m_viewport_size.y = 1;
+        set_worker_count(0);
+        m_active_quality = quality_at(0);
+    }
+
+    renderer::~renderer()
+    {
+        stop_workers();
+        delete m_frame.exchange(nullptr);
+        drop_gbuffer();
+        for (geometry_buffer* stale : m_stale_gbuffers)
+            delete stale;
+    }
+
+    void renderer::set_worker_count(size_t n)
+    {
+        if (!n)
+            n = std::thread::hardware_concurrency()*1.5;
+        if (!n)
+            n = 1;
+        stop_workers();
+        // Each worker only ever touches the G-buffer samples of its own tiles, which depend on the worker count.
+        drop_gbuffer();
+        m_worker_count = n;
+        set_mutated(MUTATION_SHADING);
     }
 
-#define make_thread ({\
-    std::thread* new_thread = new std::thread{render_worker, this, i*nLinesPerThread+m_screen_start.y, nLinesPerThread};\
-    (new_thread);\
-})
     void renderer::render()
     {
-        if (m_needs_flush && m_flush_buffers_cb) { m_flush_buffers_cb(m_userdata);m_needs_flush=0; }
-        if (!m_mutated) return;
-        // Start nproc worker threads.
-        static const size_t nproc = std::thread::hardware_concurrency()*1.5;
-//        static const size_t nproc = 1;
-        size_t nLinesPerThread = m_screen_height / nproc;
-        if (nproc <= 1)
+        flush_completed();
+        m_epochs.reclaim();
+        const uint64_t completed = m_completed_generation.load(std::memory_order_acquire);
+        // Once the scene stops changing, the last frame the governor degraded is refined
+        // a level at a time until it's at full quality.
+        const bool refine = !m_mutated && m_active_quality.level > 0 && m_published_generation && completed == m_published_generation;
+        if (!m_mutated && !refine) return;
+        if (m_workers.empty() && m_worker_count > 1)
+            start_workers();
+        const uint64_t generation = m_generation.load(std::memory_order_relaxed) + 1;
+        govern(completed, refine);
+
+        const unsigned int scale = m_active_quality.scale;
+        const bool gbuffer_ready = m_gbuffer && m_gbuffer_generation <= completed && m_gbuffer->scale == scale;
+        const bool geometry_pass = !m_deferred || m_geometry_mutated || !gbuffer_ready;
+        if (m_deferred && geometry_pass)
         {
-            render_worker(this, m_screen_start.y, nLinesPerThread);
-            goto end;
+            // The G-buffer holds one sample per block of the current scale.
+            if (m_gbuffer && m_gbuffer->scale != scale)
+                drop_gbuffer();
+            if (!m_gbuffer)
+            {
+                m_gbuffer = new geometry_buffer{};
+                m_gbuffer->scale = scale;
+                m_gbuffer->width = (m_screen_width + scale - 1) / scale;
+                m_gbuffer->samples.resize(m_gbuffer->width * ((m_screen_height + scale - 1) / scale));
+            }
+            m_gbuffer_generation = generation;
         }
-        m_workers_die = true;
+
+        frame_job* frame = new frame_job{};
+        frame->generation = generation;
+        frame->scene.reset(take_snapshot());
+        frame->gbuffer = m_deferred ? m_gbuffer : nullptr;
+        frame->geometry_pass = geometry_pass;
+        frame->quality = m_active_quality;
+        frame->remaining = std::max(m_workers.size(), (size_t)1);
+        frame->start = std::chrono::steady_clock::now();
+        m_mutated = false;
+        m_geometry_mutated = false;
+
+        // Publish the frame before its generation, so that a worker that sees the generation also sees the frame.
+        // Workers that are still on the old frame notice the new generation and abort.
+        m_epochs.retire(m_frame.exchange(frame));
+        for (geometry_buffer* stale : m_stale_gbuffers)
+            m_epochs.retire(stale);
+        m_stale_gbuffers.clear();
+        m_published_generation = generation;
+        m_generation.store(generation);
+        if (m_workers.empty())
+        {
+            render_tiles(*frame, 0, 1);
+            return;
+        }
+        m_generation.notify_all();
+    }
+
+    // An immutable copy of the scene as the application thread has it now, so that it can keep editing
+    // its objects while the workers draw this one.
+    renderer::scene_snapshot* renderer::take_snapshot()
+    {
+        scene_snapshot* scene = new scene_snapshot{};
+        scene->version = ++m_scene_version;
+        scene->camera_position = m_camera_position;
+        scene->camera_rotation = m_camera_rotation;
+        scene->bg_color = m_bg_color;
+        // Reserved up front, since the tables point into it.
+        scene->objects.reserve(m_objects.size());
+        for (auto &object : m_objects)
+        {
+            const renderable_object& copy = scene->objects.emplace_back(*object);
+            switch (copy.type)
+            {
+                case renderable_object::OBJECT_SPHERE:
+                {
+                    primary_sphere sphere = {};
+                    sphere.object = &copy;
+                    sphere.co = m_camera_position - copy.position;
+                    sphere.c = glm::dot(sphere.co, sphere.co) - copy.sphere.radius*copy.sphere.radius;
+                    scene->primary_spheres.push_back(sphere);
+                    scene->sphere_indices.push_back(scene->spheres.size());
+                    scene->spheres.push_back(&copy);
+                    break;
+                }
+                case renderable_object::OBJECT_LIGHT:
+                    scene->sphere_indices.push_back(UINT32_MAX);
+                    scene->lights.push_back(&copy);
+                    break;
+                default: assert(!"unimplemented object type");
+            }
+        }
+
+        const float d = 1;
+        scene->ray_step_x = glm::vec3(m_viewport_size.x/m_screen_end.x, 0, 0) * m_camera_rotation;
+        scene->ray_step_y = glm::vec3(0, m_viewport_size.y/m_screen_end.y, 0) * m_camera_rotation;
+        scene->ray_forward = glm::vec3(0, 0, d) * m_camera_rotation;
+        return scene;
+    }
+
+    void renderer::start_workers()
+    {
+        // No worker is inside the domain yet.
+        m_epochs.resize(m_worker_count);
+        const uint64_t generation = m_generation.load();
+        for (size_t i = 0; i < m_worker_count; i++)
+            m_workers.push_back(new std::thread{worker_main, this, i, generation});
+    }
+
+    // Aborts the frame being drawn, if any, and waits for the workers to exit.
+    void renderer::stop_workers()
+    {
+        if (m_workers.empty())
+            return;
+        m_workers_exit = true;
+        m_generation.fetch_add(1);
+        m_generation.notify_all();
         for (auto &thr : m_workers)
         {
             thr->join();
             delete thr;
         }
-        m_workers_die = false;
         m_workers.clear();
-        for (int i = 0; i < nproc; i++)
-            m_workers.push_back(make_thread);
-        end:
-        m_mutated = false;
+        m_workers_exit = false;
+        m_published_generation = 0;
     }
 
-    void renderer::render_worker(const renderer* This, int start_y, size_t nLines)
+    void renderer::worker_main(renderer* This, size_t index, uint64_t seen)
     {
-        canvas_coords i = This->m_screen_start;
-        const float d = 1;
-        i.y = start_y;
-        int lines = 0;
-        for (; lines < nLines; lines++ && !This->m_workers_die, i.y++)
+        while (true)
         {
-            for (; i.x < This->m_screen_end.x && !This->m_workers_die; i.x++)
+            const uint64_t generation = This->m_generation.load();
+            if (generation == seen)
             {
-                viewport_coords coords = {};
-                coords.x = i.x * (This->m_viewport_size.x/This->m_screen_end.x);
-                coords.y = i.y * (This->m_viewport_size.y/This->m_screen_end.y);
-                coords.z = d;
-                coords = coords * This->m_camera_rotation;
-
-                color c = This->trace_ray(This->m_camera_position, coords, 1, INFINITY, This->m_recurse_limit);
-                This->m_plot_pixel(This->m_userdata, This->conv_canvas_screen(i), c);                
+                This->m_generation.wait(seen);
+                continue;
             }
-            i.x = This->m_screen_start.x;
+            seen = generation;
+            if (This->m_workers_exit)
+                break;
+            This->m_epochs.enter(index);
+            // Can be a newer frame whose generation isn't stored yet. That one gets its own wake up.
+            const frame_job* frame = This->m_frame.load();
+            if (frame->generation == generation)
+                This->render_tiles(*frame, index, This->m_worker_count);
+            This->m_epochs.exit(index);
         }
-        This->m_needs_flush = !This->m_workers_die;
     }
-    
-#define in_range(v, min, max) (((v) >= (min)) && ((v) < (max)))
 
-    bool renderer::ray_intersects_object(viewport_coords ray_coords, viewport_coords coords, float t_min, float t_max) const
+    // Retires the G-buffer once the current frame is done with it.
+    void renderer::drop_gbuffer()
     {
-        for (auto &object : m_objects)
+        if (m_gbuffer)
+            m_stale_gbuffers.push_back(m_gbuffer);
+        m_gbuffer = nullptr;
+        m_gbuffer_generation = UINT64_MAX;
+    }
+
+    void renderer::set_deferred(bool deferred)
+    {
+        m_deferred = deferred;
+        drop_gbuffer();
+        set_mutated(MUTATION_GEOMETRY);
+    }
+
+    void renderer::flush_completed()
+    {
+        const uint64_t completed = m_completed_generation.load(std::memory_order_acquire);
+        if (completed == m_flushed_generation)
+            return;
+        m_flushed_generation = completed;
+        m_last_frame_time = std::chrono::microseconds(m_completed_frame_us.load(std::memory_order_relaxed));
+        if (m_flush_buffers_cb)
+            m_flush_buffers_cb(m_userdata);
+    }
+
+    void renderer::wait_for_frame()
+    {
+        if (!m_workers.empty())
+        {
+            uint64_t completed = 0;
+            while ((completed = m_completed_generation.load(std::memory_order_acquire)) < m_published_generation)
+                m_completed_generation.wait(completed);
+        }
+        flush_completed();
+        m_epochs.reclaim();
+    }
+
+    // From full quality to lowest.
+    static constexpr struct {
+        unsigned int scale;
+        int recurse_limit;
+        float min_ray_weight;
+    } s_quality_ladder[] = {
+        {1, INT_MAX, 0},
+        {1, INT_MAX, .05f},
+        {1, 2, .1f},
+        {2, 2, .1f},
+        {2, 1, .2f},
+        {3, 1, .25f},
+        {4, 0, 1},
+        {6, 0, 1},
+        {8, 0, 1},
+    };
+    static constexpr int s_max_quality_level = sizeof(s_quality_ladder)/sizeof(*s_quality_ladder) - 1;
+
+    // Workers are dealt square tiles of this size round-robin. Since it's a multiple of every scale, blocks never
+    // straddle tiles, and so every pixel (and G-buffer sample) is drawn by the same worker at any quality,
+    // which is what lets a frame start while workers that haven't noticed the previous one was aborted yet
+    // are still drawing it.
+    static constexpr int s_tile_size = 24;
+    static_assert([]() {
+        for (auto& level : s_quality_ladder)
+            if (s_tile_size % level.scale)
+                return false;
+        return true;
+    }(), "s_tile_size must be a multiple of every scale");
+
+    void renderer::set_target_frame_time(std::chrono::microseconds frame_time)
+    {
+        m_target_frame_time = frame_time;
+        if (frame_time.count() <= 0)
+            m_quality_level = 0;
+        set_mutated(MUTATION_SHADING);
+    }
+
+    render_quality renderer::quality_at(int level) const
+    {
+        level = std::clamp(level, 0, s_max_quality_level);
+        render_quality ret = {};
+        ret.level = level;
+        ret.scale = s_quality_ladder[level].scale;
+        ret.recurse_limit = std::min(m_recurse_limit, s_quality_ladder[level].recurse_limit);
+        ret.min_ray_weight = s_quality_ladder[level].min_ray_weight;
+        return ret;
+    }
+
+    // Called before a frame is published.
+    // Feeds the render time of the previous frame back into the quality level, and picks the quality of the next.
+    void renderer::govern(uint64_t completed, bool refine)
+    {
+        const frame_job* last = m_frame.load(std::memory_order_relaxed);
+        // Nothing to go by if the last frame was aborted by stop_workers(). Refinement frames are allowed
+        // to go over budget, so they don't count either, and the next edit starts back at the governed level.
+        if (last && last->generation == m_published_generation && !m_refining)
         {
-            float t1 = INFINITY, t2 = INFINITY;
-            switch (object->type)
+            using namespace std::chrono;
+            microseconds sample = {};
+            if (completed == last->generation)
+                sample = m_last_frame_time = microseconds(m_completed_frame_us.load(std::memory_order_relaxed));
+            else
             {
-                case renderable_object::OBJECT_SPHERE:
+                // The frame is about to be cut short by a mutation, so all that is known is that it takes
+                // at least this long. That's only worth acting on if it's already over budget.
+                sample = duration_cast<microseconds>(steady_clock::now() - last->start);
+                if (sample <= m_target_frame_time)
+                    sample = {};
+            }
+            if (m_target_frame_time.count() > 0 && sample.count() > 0)
+            {
+                // Integral control on the log of the error: back off quickly when over budget,
+                // but only creep back up when there's plenty of headroom, so it doesn't oscillate.
+                float error = log2f((float)sample.count() / m_target_frame_time.count());
+                if (error > .1f)
+                    m_quality_level += error;
+                else if (error < -.5f)
+                    m_quality_level += error * .25f;
+                m_quality_level = std::clamp(m_quality_level, 0.f, (float)s_max_quality_level);
+            }
+        }
+        m_refining = refine;
+        m_active_quality = quality_at(refine ? m_active_quality.level - 1 : (int)lroundf(m_quality_level));
+    }
+
+    // Draws the tiles of the frame that belong to the index'th of nWorkers workers.
+    void renderer::render_tiles(const frame_job& frame, size_t index, size_t nWorkers)
+    {
+        const scene_snapshot& scene = *frame.scene;
+        const render_quality& quality = frame.quality;
+        const int scale = quality.scale;
+        const int screen_end_y = m_screen_start.y + m_screen_height;
+        auto aborted = [&]() { return m_generation.load(std::memory_order_relaxed) != frame.generation; };
+        // Rays go through the middle of their block.
+        const float offset = (scale-1)*.5f;
+        const glm::vec3 block_step = (float)scale * scene.ray_step_x;
+        const size_t tiles_x = (m_screen_end.x - m_screen_start.x + s_tile_size - 1) / s_tile_size;
+        const size_t tiles_y = (m_screen_height + s_tile_size - 1) / s_tile_size;
+        canvas_coords i = m_screen_start;
+        for (size_t tile = index; tile < tiles_x*tiles_y && !aborted(); tile += nWorkers)
+        {
+            const int tile_x = m_screen_start.x + (tile % tiles_x) * s_tile_size;
+            const int tile_y = m_screen_start.y + (tile / tiles_x) * s_tile_size;
+            const int end_x = std::min(tile_x + s_tile_size, m_screen_end.x);
+            const int end_y = std::min(tile_y + s_tile_size, screen_end_y);
+            for (i.y = tile_y; i.y < end_y && !aborted(); i.y += scale)
+            {
+                // Step the ray direction across the line instead of transforming every pixel's coordinates.
+                i.x = tile_x;
+                viewport_coords coords = (i.x + offset) * scene.ray_step_x + (i.y + offset) * scene.ray_step_y + scene.ray_forward;
+                for (; i.x < end_x && !aborted(); i.x += scale, coords += block_step)
                 {
-                    auto p = intersect_ray_sphere(ray_coords, coords, *object);
-                    t1 = p.first;
-                    t2 = p.second;
-                    break;
+                    color c = {};
+                    if (!frame.gbuffer)
+                        c = trace_primary(frame, coords, quality.recurse_limit);
+                    else
+                    {
+                        gbuffer_sample* sample = &frame.gbuffer->samples[((i.y - m_screen_start.y)/scale) * frame.gbuffer->width + (i.x - m_screen_start.x)/scale];
+                        if (frame.geometry_pass)
+                        {
+                            float t = INFINITY;
+                            const renderable_object* object = closest_hit<RAY_PRIMARY>(frame, scene.camera_position, coords, 1, INFINITY, t);
+                            sample->sphere = UINT32_MAX;
+                            sample->direction = coords;
+                            if (object)
+                            {
+                                sample->sphere = scene.sphere_indices[object - scene.objects.data()];
+                                sample->position = t * coords;
+                                sample->normal = surface_normal(*object, sample->position);
+                            }
+                        }
+                        c = sample->sphere != UINT32_MAX
+                            ? shade(frame, *scene.spheres[sample->sphere], sample->position, sample->normal, sample->direction, quality.recurse_limit, 1)
+                            : scene.bg_color;
+                    }
+                    canvas_coords at = {};
+                    for (at.y = i.y; at.y < i.y + scale && at.y < screen_end_y; at.y++)
+                        for (at.x = i.x; at.x < i.x + scale && at.x < m_screen_end.x; at.x++)
+                            m_plot_pixel(m_userdata, conv_canvas_screen(at), c);
                 }
-                case renderable_object::OBJECT_LIGHT: continue;
-                default: assert(!"unimplemented object type");
             }
-            if (in_range(t1, t_min, t_max))
+        }
+        if (aborted())
+            return;
+        if (frame.remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+            auto elapsed = std::chrono::steady_clock::now() - frame.start;
+            m_completed_frame_us.store(std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count(), std::memory_order_relaxed);
+            m_completed_generation.store(frame.generation, std::memory_order_release);
+            m_completed_generation.notify_all();
+        }
+    }
+    
+#define in_range(v, min, max) (((v) >= (min)) && ((v) < (max)))
+
+    bool renderer::ray_intersects_object(const frame_job& frame, viewport_coords ray_coords, viewport_coords coords, float t_min, float t_max) const
+    {
+        // Only whether anything is in the way matters, so this stops at the first hit,
+        // and doesn't look at the nearer root if the farther one is already behind t_min.
+        const float a = glm::dot(coords,coords);
+        for (const renderable_object* sphere : frame.scene->spheres)
+        {
+            glm::vec3 co = ray_coords - sphere->position;
+            float b = 2.f*glm::dot(co, coords);
+            float c = glm::dot(co, co) - sphere->sphere.radius*sphere->sphere.radius;
+            float discriminant = b*b - 4.f * a * c;
+            if (discriminant < 0)
+                continue;
+            float root = sqrtf(discriminant);
+            float t1 = (-b + root) / (2.f*a);
+            if (t1 < t_min)
+                continue;
+            if (t1 < t_max)
                 return true;
+            float t2 = (-b - root) / (2.f*a);
             if (in_range(t2, t_min, t_max))
                 return true;
         }
         return false;
     }
 
-    color renderer::trace_ray(viewport_coords ray_coords, viewport_coords coords, float t_min, float t_max, int recurse_limit) const
+    color renderer::trace_ray(const frame_job& frame, viewport_coords ray_coords, viewport_coords coords, float t_min, float t_max, int recurse_limit, float weight) const
     {
         float closest_t = INFINITY;
-        renderable_object* closest_object = nullptr;
-        for (auto &object : m_objects)
-        {
-            float t1 = INFINITY, t2 = INFINITY;
-            switch (object->type)
-            {
-                case renderable_object::OBJECT_SPHERE:
-                {
-                    auto p = intersect_ray_sphere(ray_coords, coords, *object);
-                    t1 = p.first;
-                    t2 = p.second;
-                    break;
-                }
-                case renderable_object::OBJECT_LIGHT: continue;
-                default: assert(!"unimplemented object type");
-            }
+        const renderable_object* closest_object = closest_hit<RAY_SECONDARY>(frame, ray_coords, coords, t_min, t_max, closest_t);
+        if (!closest_object)
+            return frame.scene->bg_color;
+
+        viewport_coords intersection_coords = closest_t * coords;
+        glm::vec3 normal = surface_normal(*closest_object, intersection_coords);
+        return shade(frame, *closest_object, intersection_coords, normal, coords, recurse_limit, weight);
+    }
+
+    color renderer::trace_primary(const frame_job& frame, viewport_coords coords, int recurse_limit) const
+    {
+        float closest_t = INFINITY;
+        const renderable_object* closest_object = closest_hit<RAY_PRIMARY>(frame, frame.scene->camera_position, coords, 1, INFINITY, closest_t);
+        if (!closest_object)
+            return frame.scene->bg_color;
 
+        viewport_coords intersection_coords = closest_t * coords;
+        glm::vec3 normal = surface_normal(*closest_object, intersection_coords);
+        return shade(frame, *closest_object, intersection_coords, normal, coords, recurse_limit, 1);
+    }
+
+    // Solves |ray_coords + t*coords - position|^2 = radius^2 for every sphere, with the per-ray term
+    // hoisted out of the loop, and for primary rays the per-sphere terms taken from the frame's table.
+    template<renderer::ray_kind kind>
+    const renderable_object* renderer::closest_hit(const frame_job& frame, viewport_coords ray_coords, viewport_coords coords, float t_min, float t_max, float& closest_t) const
+    {
+        closest_t = INFINITY;
+        const renderable_object* closest_object = nullptr;
+        const float a = glm::dot(coords,coords);
+        auto test = [&](const renderable_object* object, float b, float c) {
+            float discriminant = b*b - 4.f * a * c;
+            if (discriminant < 0)
+                return;
+            float root = sqrtf(discriminant);
+            float t1 = (-b + root) / (2.f*a);
+            float t2 = (-b - root) / (2.f*a);
             if (in_range(t1, t_min, t_max) && t1 < closest_t)
             {
                 closest_t = t1;
@@ -148,55 +481,65 @@ namespace raytracer {
                 closest_t = t2;
                 closest_object = object;
             }
+        };
+        if constexpr (kind == RAY_PRIMARY)
+        {
+            for (const primary_sphere& sphere : frame.scene->primary_spheres)
+                test(sphere.object, 2.f*glm::dot(sphere.co, coords), sphere.c);
         }
+        else
+        {
+            for (const renderable_object* sphere : frame.scene->spheres)
+            {
+                glm::vec3 co = ray_coords - sphere->position;
+                test(sphere, 2.f*glm::dot(co, coords), glm::dot(co, co) - sphere->sphere.radius*sphere->sphere.radius);
+            }
+        }
+        return closest_object;
+    }
+    // Emitted out of line for the bench, since every use in here may be inlined.
+    template const renderable_object* renderer::closest_hit<renderer::RAY_PRIMARY>(const frame_job&, viewport_coords, viewport_coords, float, float, float&) const;
+    template const renderable_object* renderer::closest_hit<renderer::RAY_SECONDARY>(const frame_job&, viewport_coords, viewport_coords, float, float, float&) const;
 
-        if (!closest_object)
-            return m_bg_color;
-
-        viewport_coords intersection_coords = closest_t * coords;
+    glm::vec3 renderer::surface_normal(const renderable_object& object, viewport_coords intersection) const
+    {
         glm::vec3 normal = {};
-        if (closest_object->type == renderable_object::OBJECT_SPHERE)
+        if (object.type == renderable_object::OBJECT_SPHERE)
         {
-            normal = intersection_coords - closest_object->position;
+            normal = intersection - object.position;
             normal /= glm::length(normal);
         }
         else
             assert(!"unknown object type");
-        color local_color = closest_object->rgbx;
-        float n = compute_lighting(intersection_coords, normal, -coords, closest_object->shininess);
+        return normal;
+    }
+
+    // Lighting and reflections of a hit, everything trace_ray() does after finding what the ray hit.
+    color renderer::shade(const frame_job& frame, const renderable_object& object, viewport_coords intersection_coords, glm::vec3 normal, viewport_coords coords, int recurse_limit, float weight) const
+    {
+        color local_color = object.rgbx;
+        float n = compute_lighting(frame, intersection_coords, normal, -coords, object.shininess);
         local_color = color_multiply(local_color, n);
         
-        if (recurse_limit <= 0 || closest_object->reflectiveness <= 0)
+        if (recurse_limit <= 0 || object.reflectiveness <= 0)
+            return local_color;
+        // Not worth a ray if it can barely affect the pixel.
+        const float reflected_weight = weight * object.reflectiveness;
+        if (reflected_weight < frame.quality.min_ray_weight)
             return local_color;
 
         glm::vec3 reflected_ray = 2.f * normal * glm::dot(normal, -coords) - (-coords);
-        color reflected_color = trace_ray(intersection_coords, reflected_ray, 0.001, INFINITY, recurse_limit - 1);
-        local_color = color_multiply(local_color, (1.f-closest_object->reflectiveness));
-        reflected_color = color_multiply(reflected_color, closest_object->reflectiveness);
+        color reflected_color = trace_ray(frame, intersection_coords, reflected_ray, 0.001, INFINITY, recurse_limit - 1, reflected_weight);
+        local_color = color_multiply(local_color, (1.f-object.reflectiveness));
+        reflected_color = color_multiply(reflected_color, object.reflectiveness);
         return local_color + reflected_color;
     }
 
-    std::pair<float /* t1 */, float /* t2 */> renderer::intersect_ray_sphere(viewport_coords ray_coords, viewport_coords coords, const renderable_object& sphere) const
-    {
-        glm::vec3 co = ray_coords - sphere.position;
-        float a = glm::dot(coords,coords);
-        float b = 2.f*glm::dot(co, coords);
-        float c = glm::dot(co, co) - sphere.sphere.radius*sphere.sphere.radius;
-
-        float discriminant = b*b - 4.f * a * c;
-        if (discriminant < 0) { return {INFINITY,INFINITY}; }
-    
-        float t1 = (-b + (float)sqrt(discriminant)) / (2.f*a);
-        float t2 = (-b - (float)sqrt(discriminant)) / (2.f*a);
-        return {t1,t2};
-    }
-
-    float renderer::compute_lighting(viewport_coords intersection, glm::vec3 normal, glm::vec3 camera_distance, float shininess) const
+    float renderer::compute_lighting(const frame_job& frame, viewport_coords intersection, glm::vec3 normal, glm::vec3 camera_distance, float shininess) const
     {
         float n = 0;
-        for (auto& light : m_objects)
+        for (auto& light : frame.scene->lights)
         {
-            if (light->type != renderable_object::OBJECT_LIGHT) continue;
             switch (light->light.type) {
                 case renderable_object::LIGHT_AMBIENT:
                     n += light->light.intensity;
@@ -216,7 +559,7 @@ namespace raytracer {
                         direction = light->direction;
                         t_max = INFINITY;
                     }
-                    if (ray_intersects_object(intersection, direction, 0.001, t_max))
+                    if (ray_intersects_object(frame, intersection, direction, 0.001, t_max))
                         continue;
                     float dot_l = glm::dot(normal, direction);
                     if (dot_l > 0) n += light->light.intensity * dot_l / (glm::length(normal)*glm::length(direction));
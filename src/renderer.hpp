@@ -10,10 +10,17 @@
 #include <glm/vec2.hpp>
 #include <glm/vec3.hpp>
 #include <glm/vec4.hpp>
+#include <atomic>
+#include <chrono>
 #include <list>
 #include <thread>
+#include <vector>
 #include <utility>
 #include <algorithm>
+#include <memory>
+#include <cstdint>
+
+#include "epoch.hpp"
 
 namespace raytracer {
     using viewport_coords = glm::vec3;
@@ -68,29 +75,139 @@ namespace raytracer {
         };
     };
     
+    // What a mutation of the scene can have changed, see renderer::set_mutated().
+    enum mutation_kind {
+        // Only lights, materials (color, shininess, reflectiveness) or the background color.
+        MUTATION_SHADING,
+        // Anything that can change what primary rays hit: the camera, sphere positions or radii, or the set of spheres.
+        MUTATION_GEOMETRY,
+    };
+
+    // The settings the frame governor trades for speed. Level 0 is full quality.
+    struct render_quality {
+        int level;
+        // Each traced ray covers a scale x scale block of the screen.
+        unsigned int scale;
+        int recurse_limit;
+        // Reflections contributing less than this fraction of a pixel's color aren't traced.
+        float min_ray_weight;
+    };
+
+    // Scene edits (append_object(), remove_object(), the camera and background setters, and
+    // set_mutated() after changing an object in place) only touch the application thread's copy
+    // of the scene. The next render() publishes all of them together as an immutable snapshot
+    // that the workers pick up for their next frame, so edits never have to wait for, or stop,
+    // the workers. Snapshots are reclaimed once no worker can still be reading them.
     class renderer {
         public:
             renderer() = delete;
             renderer(const renderer&) = delete;
             renderer(renderer&&) = delete;
             renderer(int screen_width, int screen_height, plot_pixel_cb cb, void* userdata, color bg_color, int recurse_limit);
+            ~renderer();
     
             void render();
+            // Blocks until the frame started by the last render() has been fully drawn, then flushes it.
+            void wait_for_frame();
             inline void set_camera_position(const viewport_coords& new_pos) { set_mutated(); m_camera_position = new_pos; }
             inline void set_camera_rotation(const glm::mat3x3& rot) { set_mutated(); m_camera_rotation = rot; }
-            inline void set_flush_buffers_cb(void(*cb)(void* userdata)) { set_mutated(); m_flush_buffers_cb = cb; }
+            inline void set_flush_buffers_cb(void(*cb)(void* userdata)) { set_mutated(MUTATION_SHADING); m_flush_buffers_cb = cb; }
             inline viewport_coords get_camera_position() { return m_camera_position; }
             inline glm::mat3x3 get_camera_rotation() { return m_camera_rotation; }
-            inline void append_object(renderable_object* obj) { set_mutated(); m_objects.emplace_back(obj); }
-            inline void remove_object(renderable_object* obj) { set_mutated(); m_objects.remove(obj); }
-            inline void set_bg_color(color c) { set_mutated(); m_bg_color=c; }
+            inline void append_object(renderable_object* obj) { set_mutated(mutation_of(obj)); m_objects.emplace_back(obj); }
+            inline void remove_object(renderable_object* obj) { set_mutated(mutation_of(obj)); m_objects.remove(obj); }
+            inline void set_bg_color(color c) { set_mutated(MUTATION_SHADING); m_bg_color=c; }
             inline color get_bg_color() { return m_bg_color; }
-            inline void set_mutated() { m_mutated = true; }
+            // Call after changing an object in place. Pass MUTATION_SHADING when only lights or materials
+            // changed, so that a deferred renderer can skip intersecting primary rays again.
+            inline void set_mutated(mutation_kind kind = MUTATION_GEOMETRY) { m_mutated = true; m_geometry_mutated |= (kind == MUTATION_GEOMETRY); }
+            // In deferred mode, the primary hit of every pixel is kept in a G-buffer, and frames after
+            // shading-only mutations redo the lighting and reflections from it instead of tracing primary rays.
+            void set_deferred(bool deferred);
+            inline bool is_deferred() const { return m_deferred; }
+            // 0 picks a default based on std::thread::hardware_concurrency().
+            // Unlike scene edits, this stops the workers and waits for them.
+            void set_worker_count(size_t n);
+            inline size_t get_worker_count() const { return m_worker_count; }
+            // Version of the last scene snapshot published by render(), 0 before the first.
+            inline uint64_t get_scene_version() const { return m_scene_version; }
+
+            // Makes the governor adapt the render quality after every frame so that frames
+            // take about frame_time to render. A zero frame_time disables it and restores full quality.
+            // While nothing changes, render() keeps refining the last frame up to full quality regardless.
+            void set_target_frame_time(std::chrono::microseconds frame_time);
+            inline void set_target_fps(int fps) { set_target_frame_time(std::chrono::microseconds(fps > 0 ? 1000000/fps : 0)); }
+            // Quality of the last frame started by render().
+            inline render_quality get_quality() const { return m_active_quality; }
+            // Changes whenever render() or wait_for_frame() flushes a newly completed frame.
+            inline uint64_t get_flushed_frame() const { return m_flushed_generation; }
+            // Render time of the last frame that was drawn to completion.
+            inline std::chrono::microseconds get_last_frame_time() const { return m_last_frame_time; }
 
         private:
+            // The primary hit of one ray of the frame. The material is read from the scene when shading,
+            // since material changes are exactly what the G-buffer is kept around for.
+            struct gbuffer_sample {
+                // Index into scene_snapshot::spheres, which shading-only mutations don't change.
+                // UINT32_MAX if the ray hit nothing.
+                uint32_t sphere;
+                viewport_coords position;
+                glm::vec3 normal;
+                viewport_coords direction;
+            };
+            struct geometry_buffer {
+                // One sample per block of this scale.
+                unsigned int scale;
+                size_t width;
+                std::vector<gbuffer_sample> samples;
+            };
+
+            struct primary_sphere {
+                const renderable_object* object;
+                // co and c of the intersection quadratic in closest_hit(), which only depend on the ray origin,
+                // and so are the same for every primary ray.
+                glm::vec3 co;
+                float c;
+            };
+            // An immutable copy of the scene, along with the tables the ray kernels need.
+            struct scene_snapshot {
+                uint64_t version;
+                std::vector<renderable_object> objects;
+                viewport_coords camera_position;
+                glm::mat3x3 camera_rotation;
+                color bg_color;
+                // Point into objects.
+                std::vector<primary_sphere> primary_spheres;
+                std::vector<const renderable_object*> spheres;
+                std::vector<const renderable_object*> lights;
+                // Index into spheres of every object, UINT32_MAX for lights.
+                std::vector<uint32_t> sphere_indices;
+                // The primary ray through canvas coordinates (x,y) is x*ray_step_x + y*ray_step_y + ray_forward.
+                glm::vec3 ray_step_x, ray_step_y, ray_forward;
+            };
+            // Everything the workers need to draw one frame. Immutable once published, except for remaining.
+            struct frame_job {
+                uint64_t generation;
+                std::unique_ptr<const scene_snapshot> scene;
+                // nullptr unless deferred. Shared by the frames until the next geometry pass at another scale.
+                geometry_buffer* gbuffer;
+                // Whether this frame fills the G-buffer, or only shades what's in it.
+                bool geometry_pass;
+                render_quality quality;
+                std::chrono::steady_clock::time_point start;
+                // Workers yet to finish their tiles. The one that brings it to zero completes the frame.
+                mutable std::atomic<size_t> remaining;
+            };
+
+            // The application thread's copy of the scene.
             std::list<renderable_object*> m_objects = {};
             viewport_coords m_camera_position = {};
             glm::mat3x3 m_camera_rotation = {};
+            color m_bg_color = {};
+            bool m_mutated = true;
+            bool m_geometry_mutated = true;
+            uint64_t m_scene_version = 0;
+
             plot_pixel_cb m_plot_pixel = {};
             void(*m_flush_buffers_cb)(void* userdata) = nullptr;
             int m_recurse_limit = {};
@@ -101,18 +218,63 @@ namespace raytracer {
             canvas_coords m_screen_start = {};
             glm::vec2 m_viewport_size = {};
             void* m_userdata = {};
-            color m_bg_color = {};
-            bool m_mutated = true;
-            mutable bool m_needs_flush = false;
-            bool m_workers_die = false;
+
+            // The frame the workers should be drawing, published with RCU.
+            std::atomic<frame_job*> m_frame = nullptr;
+            epoch_domain m_epochs;
+            // Bumped to publish a frame, and to abort the one being drawn. Workers wait on it.
+            std::atomic<uint64_t> m_generation = 0;
+            // Generation of the last frame that was drawn to completion, and how long it took.
+            std::atomic<uint64_t> m_completed_generation = 0;
+            std::atomic<int64_t> m_completed_frame_us = 0;
+            // Generation of the frame wait_for_frame() waits for, 0 if there's none.
+            uint64_t m_published_generation = 0;
+            uint64_t m_flushed_generation = 0;
+            std::atomic<bool> m_workers_exit = false;
+            // Empty when rendering on the application thread.
             std::list<std::thread*> m_workers = {};
+            size_t m_worker_count = {};
+
+            std::chrono::microseconds m_target_frame_time = {};
+            std::chrono::microseconds m_last_frame_time = {};
+            // Quality level as tracked by the governor, rounded to pick the current level.
+            float m_quality_level = 0;
+            render_quality m_active_quality = {};
+            // Whether the last frame published is a refinement of the one before.
+            bool m_refining = false;
+
+            bool m_deferred = false;
+            geometry_buffer* m_gbuffer = nullptr;
+            // Generation of the last frame that filled m_gbuffer. Its samples are usable once that frame completed.
+            uint64_t m_gbuffer_generation = UINT64_MAX;
+            // Replaced G-buffers, which the current frame can still be using. Retired by the next render().
+            std::vector<geometry_buffer*> m_stale_gbuffers = {};
 
         private:
-            static void render_worker(const renderer* This, int start_y, size_t nLines);
+            friend struct bench;
+            static void worker_main(renderer* This, size_t index, uint64_t seen);
+            void render_tiles(const frame_job& frame, size_t index, size_t nWorkers);
+            void start_workers();
+            void stop_workers();
+            void govern(uint64_t completed, bool refine);
+            render_quality quality_at(int level) const;
+            void flush_completed();
+            void drop_gbuffer();
+            scene_snapshot* take_snapshot();
+            static inline mutation_kind mutation_of(const renderable_object* obj)
+            { return obj->type == renderable_object::OBJECT_LIGHT ? MUTATION_SHADING : MUTATION_GEOMETRY; }
             screen_coords conv_canvas_screen(const canvas_coords& coords) const;
-            color trace_ray(viewport_coords ray_coords, viewport_coords coords, float t_min, float t_max, int recurse_limit) const;
-            bool ray_intersects_object(viewport_coords ray_coords, viewport_coords coords, float t_min, float t_max) const;
-            float compute_lighting(viewport_coords intersection, glm::vec3 normal, glm::vec3 camera_distance, float shininess) const;
-            std::pair<float /* t1 */, float /* t2 */> intersect_ray_sphere(viewport_coords ray_coords, viewport_coords coords, const renderable_object& sphere) const;
+            color trace_ray(const frame_job& frame, viewport_coords ray_coords, viewport_coords coords, float t_min, float t_max, int recurse_limit, float weight = 1) const;
+            // Primary rays start at the camera and can use the per-frame sphere constants,
+            // secondary rays (reflections) start anywhere.
+            enum ray_kind { RAY_PRIMARY, RAY_SECONDARY };
+            template<ray_kind kind>
+            const renderable_object* closest_hit(const frame_job& frame, viewport_coords ray_coords, viewport_coords coords, float t_min, float t_max, float& closest_t) const;
+            color trace_primary(const frame_job& frame, viewport_coords coords, int recurse_limit) const;
+            glm::vec3 surface_normal(const renderable_object& object, viewport_coords intersection) const;
+            color shade(const frame_job& frame, const renderable_object& object, viewport_coords intersection, glm::vec3 normal, viewport_coords coords, int recurse_limit, float weight) const;
+            // Any-hit test for shadow rays.
+            bool ray_intersects_object(const frame_job& frame, viewport_coords ray_coords, viewport_coords coords, float t_min, float t_max) const;
+            float compute_lighting(const frame_job& frame, viewport_coords intersection, glm::vec3 normal, glm::vec3 camera_distance, float shininess) const;
     };
 }
\ No newline at end of file
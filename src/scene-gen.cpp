@@ -0,0 +1,67 @@
+/*
+ * src/scene-gen.cpp
+ *
+ * Copyright (c) 2025 Omar Berrow
+*/
+
+#include <algorithm>
+#include <cmath>
+
+#include "scene-gen.hpp"
+
+namespace raytracer {
+    // xorshift32, so that scenes don't depend on the standard library's distributions.
+    static float next_float(uint32_t& state)
+    {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return (state >> 8) * (1.f / 16777216.f);
+    }
+
+    std::vector<renderable_object> generate_scene(size_t nSpheres, uint32_t seed)
+    {
+        std::vector<renderable_object> scene;
+        scene.reserve(nSpheres + 3);
+        uint32_t state = seed ? seed : 0x9e3779b9;
+
+        const float extent = std::max(2.f, 2.f*std::cbrt((float)nSpheres));
+        const float radius = .6f * extent / std::cbrt((float)nSpheres);
+        for (size_t i = 0; i < nSpheres; i++)
+        {
+            renderable_object obj = {};
+            obj.position = {
+                (next_float(state) - .5f) * extent,
+                (next_float(state) - .5f) * extent,
+                3 + radius + next_float(state) * extent,
+            };
+            obj.shininess = next_float(state) < .2f ? -1 : 10 + next_float(state) * 990;
+            obj.reflectiveness = next_float(state) * .5f;
+            obj.rgbx = (uint32_t(next_float(state)*255) << 24) |
+                       (uint32_t(next_float(state)*255) << 16) |
+                       (uint32_t(next_float(state)*255) << 8);
+            obj.sphere.radius = radius * (.5f + next_float(state));
+            obj.type = renderable_object::OBJECT_SPHERE;
+            scene.push_back(obj);
+        }
+
+        renderable_object light = {};
+        light.rgbx = 0xffffffff;
+        light.type = renderable_object::OBJECT_LIGHT;
+
+        light.light.intensity = .2f;
+        light.light.type = renderable_object::LIGHT_AMBIENT;
+        scene.push_back(light);
+
+        light.position = {2,-1,0};
+        light.light.intensity = .6f;
+        light.light.type = renderable_object::LIGHT_POINT;
+        scene.push_back(light);
+
+        light.direction = {1,4,4};
+        light.light.intensity = .2f;
+        light.light.type = renderable_object::LIGHT_DIRECTIONAL;
+        scene.push_back(light);
+        return scene;
+    }
+}
@@ -0,0 +1,21 @@
+/*
+ * src/scene-gen.hpp
+ *
+ * Copyright (c) 2025 Omar Berrow
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "renderer.hpp"
+
+namespace raytracer {
+    // Generates a deterministic scene of nSpheres spheres in front of the default camera,
+    // lit by the same three lights as scene.hpp.
+    // The spheres are spread over a volume that grows with nSpheres, so coverage of the
+    // screen stays roughly the same regardless of the count.
+    // The same seed always gives the same scene, on every platform.
+    std::vector<renderable_object> generate_scene(size_t nSpheres, uint32_t seed);
+}
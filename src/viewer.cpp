@@ -0,0 +1,213 @@
+/*
+ * src/viewer.cpp
+ *
+ * Copyright (c) 2025 Omar Berrow
+*/
+
+// Minimal viewer for the remote frontend (main-remote.cpp).
+// Shows the frames it streams in an SDL window, and sends the camera keys back to it.
+
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_events.h>
+#include <SDL2/SDL_keycode.h>
+#include <SDL2/SDL_video.h>
+#include <SDL2/SDL_surface.h>
+#include <SDL2/SDL_quit.h>
+
+#include <chrono>
+#include <vector>
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <poll.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+#include "headless.hpp"
+#include "remote.hpp"
+
+#define psdlerror(s) fprintf(stderr, "%s: %s\n", s, SDL_GetError())
+
+constexpr int target_fps = 60;
+
+using namespace raytracer;
+
+static int connect_to(const char* host, const char* port)
+{
+    addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* res = nullptr;
+    int err = getaddrinfo(host, port, &hints, &res);
+    if (err)
+    {
+        fprintf(stderr, "%s: %s\n", host, gai_strerror(err));
+        return -1;
+    }
+    int fd = -1;
+    for (addrinfo* ai = res; ai; ai = ai->ai_next)
+    {
+        fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (fd < 0)
+            continue;
+        if (connect(fd, ai->ai_addr, ai->ai_addrlen) == 0)
+            break;
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(res);
+    if (fd < 0)
+        perror("connect");
+    return fd;
+}
+
+// Reads one frame message and applies its tiles to img. Returns false on disconnect or bad data.
+static bool recv_frame(int fd, headless_image& img)
+{
+    uint8_t header[12] = {};
+    if (!remote_recv_all(fd, header, sizeof(header)))
+        return false;
+    uint32_t frame_index = remote_get_u32(header);
+    uint32_t tile_count = remote_get_u32(header+4);
+    uint32_t payload_size = remote_get_u32(header+8);
+    std::vector<uint8_t> payload(payload_size);
+    if (!remote_recv_all(fd, payload.data(), payload.size()))
+        return false;
+
+    auto start = std::chrono::steady_clock::now();
+    size_t off = 0;
+    for (uint32_t i = 0; i < tile_count; i++)
+    {
+        if (off + 8 > payload.size())
+            return false;
+        uint16_t tx = remote_get_u16(&payload[off]);
+        uint16_t ty = remote_get_u16(&payload[off+2]);
+        uint32_t size = remote_get_u32(&payload[off+4]);
+        off += 8;
+        if (size > payload.size() - off || !remote_decode_tile(img, tx, ty, &payload[off], size))
+        {
+            fprintf(stderr, "frame %u: bad tile (%u,%u)\n", frame_index, tx, ty);
+            return false;
+        }
+        off += size;
+    }
+    auto end = std::chrono::steady_clock::now();
+    printf("frame %u: %u tiles, %zu bytes, decode %.3f ms\n",
+        frame_index, tile_count, sizeof(header) + payload.size(),
+        std::chrono::duration<double, std::milli>(end - start).count());
+    return true;
+}
+
+static void blit(const headless_image& img, SDL_Surface* surface)
+{
+    SDL_LockSurface(surface);
+    uint8_t* fb8 = (uint8_t*)surface->pixels;
+    for (unsigned int y = 0; y < img.height && y < surface->h; y++)
+    {
+        for (unsigned int x = 0; x < img.width && x < surface->w; x++)
+        {
+            color rgbx = img.at(x, y);
+            uint8_t* px = fb8 + surface->pitch * y + x*surface->format->BytesPerPixel;
+            px[surface->format->Rshift/8] = rgbx >> 24;
+            px[surface->format->Gshift/8] = (rgbx >> 16) & 0xff;
+            px[surface->format->Bshift/8] = (rgbx >> 8) & 0xff;
+            if (surface->format->Amask)
+                px[surface->format->Ashift/8] = 0;
+        }
+    }
+    SDL_UnlockSurface(surface);
+}
+
+int main(int argc, char** argv)
+{
+    const char* host = argc > 1 ? argv[1] : "127.0.0.1";
+    char default_port[8] = {};
+    snprintf(default_port, sizeof(default_port), "%u", remote_default_port);
+    const char* port = argc > 2 ? argv[2] : default_port;
+
+    int fd = connect_to(host, port);
+    if (fd < 0)
+        return -1;
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    remote_hello hello = {};
+    if (!remote_recv_hello(fd, hello))
+    {
+        fprintf(stderr, "%s:%s: handshake failed\n", host, port);
+        return -1;
+    }
+
+    if (SDL_Init(SDL_INIT_VIDEO) == -1)
+    {
+        psdlerror("SDL_Init");
+        return -1;
+    }
+    SDL_Window* window = SDL_CreateWindow(
+        "Raytracer (remote)",
+        SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED,
+        hello.width, hello.height,
+        0);
+    if (!window)
+    {
+        psdlerror("SDL_CreateWindow");
+        return -1;
+    }
+    SDL_Surface* surface = SDL_GetWindowSurface(window);
+    if (!surface)
+    {
+        psdlerror("SDL_GetWindowSurface");
+        return -1;
+    }
+
+    headless_image img(hello.width, hello.height);
+    bool quit = false;
+    do {
+        SDL_Event event = {};
+        while (SDL_PollEvent(&event))
+        {
+            if (event.type == SDL_KEYDOWN)
+            {
+                uint8_t key = 0;
+                switch (event.key.keysym.sym) {
+                    case 'w': key = REMOTE_KEY_FORWARD; break;
+                    case 's': key = REMOTE_KEY_BACKWARD; break;
+                    case 'a': key = REMOTE_KEY_LEFT; break;
+                    case 'd': key = REMOTE_KEY_RIGHT; break;
+                    case SDLK_UP: key = REMOTE_KEY_UP; break;
+                    case SDLK_DOWN: key = REMOTE_KEY_DOWN; break;
+                    default: break;
+                }
+                if (key && !remote_send_all(fd, &key, 1))
+                    quit = true;
+            }
+            else if (event.type == SDL_QUIT)
+            {
+                quit = true;
+                break;
+            }
+        }
+
+        pollfd pfd = {fd, POLLIN, 0};
+        if (!quit && poll(&pfd, 1, 1000/target_fps) > 0)
+        {
+            if (!recv_frame(fd, img))
+            {
+                fprintf(stderr, "%s:%s: connection lost\n", host, port);
+                quit = true;
+                break;
+            }
+            blit(img, surface);
+            SDL_UpdateWindowSurface(window);
+        }
+    } while(!quit);
+
+    close(fd);
+    SDL_DestroyWindow(window);
+    SDL_Quit();
+
+    return 0;
+}